@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+//---------------------------------------------------------------
+// Binary grid files. A file is a header padded out to
+// GRID_HEADER_BYTES, so the data after it is page aligned and can
+// be mapped straight in, followed by rows x cols values row by
+// row in the machine's own byte order. Checkpoints are ordinary
+// grid files with the number of sweeps already done filled in.
+//---------------------------------------------------------------
+#define GRID_MAGIC "RLXGRID1"
+#define GRID_HEADER_BYTES 4096
+
+#define GRID_DTYPE_FLOAT64 1
+
+
+struct gridHeader {
+    //---------------------------------------------------------------
+    // boundary holds the top, bottom, left and right edge values
+    // when hasBoundary is set, the edges of the data are what is
+    // actually solved with either way.
+    //---------------------------------------------------------------
+	char magic[8];
+	uint32_t dtype;
+	uint32_t hasBoundary;
+	uint64_t rows;
+	uint64_t cols;
+	double boundary[4];
+	uint64_t sweeps;
+	double precision;
+	double residual;
+};
+
+
+void initGridHeader(struct gridHeader *header, int rows, int cols){
+	memset(header, 0, sizeof(struct gridHeader));
+	memcpy(header->magic, GRID_MAGIC, sizeof(header->magic));
+	header->dtype = GRID_DTYPE_FLOAT64;
+	header->rows = rows;
+	header->cols = cols;
+}
+
+
+size_t gridDataBytes(struct gridHeader *header){
+    //---------------------------------------------------------------
+    // The bytes of data after the header, or 0 when rows x cols
+    // doubles and the header would not fit in a size_t. Checked by
+    // dividing, as the product itself could wrap.
+    //---------------------------------------------------------------
+	size_t most = (SIZE_MAX - GRID_HEADER_BYTES) / sizeof(double);
+	if (header->rows == 0 || header->rows > most ||
+	    header->cols > most / header->rows){
+		return 0;
+	}
+	return (size_t)header->rows*header->cols*sizeof(double);
+}
+
+
+void readGridHeader(const char *path, struct gridHeader *header){
+    //---------------------------------------------------------------
+    // Reads and checks the header of a grid file
+    //---------------------------------------------------------------
+	FILE *file = fopen(path, "rb");
+	if (file == NULL){
+		printf("Could not open grid file '%s'.\n", path);
+		exit(0);
+	}
+	size_t read = fread(header, sizeof(struct gridHeader), 1, file);
+	fclose(file);
+
+	if (read != 1 || memcmp(header->magic, GRID_MAGIC, sizeof(header->magic)) != 0){
+		printf("'%s' is not a grid file.\n", path);
+		exit(0);
+	}
+	if (header->dtype != GRID_DTYPE_FLOAT64){
+		printf("Grid file '%s' has an unknown data type.\n", path);
+		exit(0);
+	}
+	if (header->rows < 3 || header->cols < 3){
+		printf("Grid file '%s' is smaller than 3x3.\n", path);
+		exit(0);
+	}
+	if (header->rows > INT_MAX || header->cols > INT_MAX ||
+	    gridDataBytes(header) == 0){
+		printf("Grid file '%s' is too large.\n", path);
+		exit(0);
+	}
+}
+
+
+double **openMatrixMapped(const char *path, struct gridHeader *header){
+    //---------------------------------------------------------------
+    // Maps a grid file privately and points a row table into it, so
+    // nothing is read until it is touched and pages written to are
+    // copied rather than changing the file. Close it with
+    // closeMatrixMapped.
+    //---------------------------------------------------------------
+	readGridHeader(path, header);
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0){
+		printf("Could not open grid file '%s'.\n", path);
+		exit(0);
+	}
+
+	struct stat st;
+	size_t bytes = GRID_HEADER_BYTES + gridDataBytes(header);
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < bytes){
+		printf("Grid file '%s' is shorter than its header says.\n", path);
+		exit(0);
+	}
+
+	char *file = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (file == MAP_FAILED){
+		printf("Could not map grid file '%s'.\n", path);
+		exit(0);
+	}
+
+	double **matrix = malloc(header->rows*sizeof(double*));
+	if (matrix == NULL){
+		printf("matrix is null so exiting");
+		exit(0);
+	}
+
+	double *buf = (double *)(file + GRID_HEADER_BYTES);
+	for (size_t i=0; i<header->rows; i++){
+		matrix[i] = buf + header->cols*i;
+	}
+	return matrix;
+}
+
+
+void closeMatrixMapped(double ***matrix, struct gridHeader *header){
+	munmap((char *)(*matrix)[0] - GRID_HEADER_BYTES,
+	       GRID_HEADER_BYTES + gridDataBytes(header));
+	free(*matrix);
+	*matrix = NULL;
+}
+
+
+int writeAll(int fd, const char *data, size_t bytes){
+	while (bytes > 0){
+		ssize_t written = write(fd, data, bytes);
+		if (written <= 0){
+			return -1;
+		}
+		data += written;
+		bytes -= written;
+	}
+	return 0;
+}
+
+
+int writeGridFile(const char *path, double ***matrix,
+                  struct gridHeader *header){
+
+    //---------------------------------------------------------------
+    // Writes a grid file next to path and renames it into place once
+    // it is safely on disk, so a crash part way through leaves the
+    // previous file whole. Returns 0, or -1 if it could not be
+    // written.
+    //---------------------------------------------------------------
+	size_t length = strlen(path);
+	char *temp = malloc(length + 5);
+	memcpy(temp, path, length);
+	memcpy(temp + length, ".tmp", 5);
+
+	int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0){
+		free(temp);
+		return -1;
+	}
+
+	char *block = calloc(1, GRID_HEADER_BYTES);
+	memcpy(block, header, sizeof(struct gridHeader));
+	int failed = writeAll(fd, block, GRID_HEADER_BYTES);
+	free(block);
+
+    //---------------------------------------------------------------
+    // Matrices from createMatrix are one buffer, but write row by
+    // row so any row table will do.
+    //---------------------------------------------------------------
+	for (size_t i=0; i<header->rows && !failed; i++){
+		failed = writeAll(fd, (const char *)(*matrix)[i],
+		                  header->cols*sizeof(double));
+	}
+	if (!failed){
+		failed = fsync(fd);
+	}
+	close(fd);
+
+	if (!failed){
+		failed = rename(temp, path);
+	}
+	if (failed){
+		unlink(temp);
+	}
+	free(temp);
+	return failed ? -1 : 0;
+}
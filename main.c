@@ -1,389 +1,734 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <time.h>
 #include <string.h>
+#include <stdarg.h>
 
 #include <pthread.h>
 #include <unistd.h>
 
 #include "matrixWizard.c"
+#include "gridFile.c"
+#include "relaxKernel.c"
+#include "multigrid.c"
+#include "relaxSolver.c"
 
 #define true 1;
 #define false 0;
 
-pthread_barrier_t barrier;
-
 
-struct assignedRows {
+struct gridSetup {
     //---------------------------------------------------------------
-    // Stores data for row assignment
+    // The shape of the matrix to solve, and the value held along
+    // each edge when a boundary is given. Without one the whole
+    // matrix, edges included, is random. With an input file the
+    // matrix comes from there instead, and the final matrix is
+    // written to the output file if one is given.
     //---------------------------------------------------------------
-    int *assignedStartRow;
-    int *assignedNumberOfRows;
-};
+    int rows;
+    int cols;
+    int hasBoundary;
 
-struct thread_args{
     //---------------------------------------------------------------
-    // Encapsulates the arguments passed to a thread
+    // The planes of a 3D volume, given as planesxrowsxcols, or 0 for
+    // a matrix. Volumes always start random.
     //---------------------------------------------------------------
-    double ***matrix;
-    double ***lastMatrix;
-    int **rowsComplete;
+    int planes;
+    double top;
+    double bottom;
+    double left;
+    double right;
+    const char *inputPath;
+    const char *outputPath;
 
-    int threadNumber;
-    int totalThreads;
-    int scale;
-    int rowFrom;
-    int rowTo;
-    double precision;
-};
+    //---------------------------------------------------------------
+    // A second boundary to re-solve with, starting from the first
+    // answer, in 'Single' mode.
+    //---------------------------------------------------------------
+    int hasReboundary;
+    double reboundary[4];
 
+    //---------------------------------------------------------------
+    // The number of grids of this shape solved together in 'Batch'
+    // mode.
+    //---------------------------------------------------------------
+    int batchCount;
 
+    //---------------------------------------------------------------
+    // The seed random matrices are filled from, so runs given the
+    // same seed start from the same matrix.
+    //---------------------------------------------------------------
+    unsigned int seed;
 
-void getArgs(int* scale,        int *threads, 
-             double* precision, char *type, 
-             int argc,          char* argv[]){
+    //---------------------------------------------------------------
+    // The source field and coefficients of the equation, each a
+    // number for the same value everywhere or a grid file of this
+    // shape, with coefficients also taking north,west edge files.
+    // NULL solves Laplace's equation. problem is what they build.
+    //---------------------------------------------------------------
+    const char *sourceSpec;
+    const char *coefficientSpec;
+    struct relaxProblem problem;
 
-    printf("\n");
-    
     //---------------------------------------------------------------
-    // Check the correct amount of arguments are given
+    // A grid file of this shape that is not 0 at the interior cells
+    // held fixed, or NULL for none, and the mask made from it.
     //---------------------------------------------------------------
-    if (argc < 5){
-        printf("Not enough arguments, please provide arguments for");
-        printf(" 'Scale', 'Threads', 'Precision', and 'Type'.\n");
-        exit(0);
-    }
-    if (argc > 5){
-        printf("Too many arguments, please only provide arguments for");
-        printf(" 'Scale', 'Threads', 'Precision', and 'Type'.\n");
-        exit(0);
-    }
+    const char *maskPath;
+    struct cellMask mask;
+};
 
 
+struct benchmarkSetup {
     //---------------------------------------------------------------
-    // Collect arguments and put them into the addresses given
+    // What 'Test' mode measures. Each list is comma separated, and
+    // left NULL measures only the scale, precision and method given,
+    // on every thread count up to the threads given. Each setting is
+    // solved 'warmups' times untimed then 'runs' times timed, and the
+    // results are also written to csvPath and jsonPath when given.
     //---------------------------------------------------------------
-    *scale = atoi(argv[1]);
-    *threads = atoi(argv[2]);
-    sscanf(argv[3], "%lf", precision);
-    *type = argv[4][0];
+    const char *scales;
+    const char *threads;
+    const char *precisions;
+    const char *variants;
+    int runs;
+    int warmups;
+    const char *csvPath;
+    const char *jsonPath;
+};
 
-    if (*threads < 1){
-        printf("You cannot run on less than 1 thread.\n");
-        printf("Exiting\n");
-        exit(0);
-    }
+
+struct benchmarkResult {
+    //---------------------------------------------------------------
+    // The timings of one setting of the benchmark
+    //---------------------------------------------------------------
+    int rows;
+    int cols;
+    int threads;
+    double precision;
+    char variant[16];
+    int sweeps;
+    double median;
+    double p95;
+    double sweepsPerSecond;
+    double glups;
+    double gbps;
+};
 
 
+void describeGrid(struct gridHeader *header, struct gridSetup *grid){
     //---------------------------------------------------------------
-    // Print arguments
+    // Copies the boundary of a grid into a file header
     //---------------------------------------------------------------
+    header->hasBoundary = grid->hasBoundary;
+    header->boundary[0] = grid->top;
+    header->boundary[1] = grid->bottom;
+    header->boundary[2] = grid->left;
+    header->boundary[3] = grid->right;
+}
 
-    printf("Arguments set as...\n");
-    printf("Scale     = %d\n", *scale);
-    printf("Threads   = %d\n", *threads);
-    printf("Precision = %f\n", *precision);
 
-    if (*type == 't'){
-        printf("Type      = Test\n");
+void setupMatrix(struct relaxContext *ctx, double ***m,
+                 struct gridSetup *grid){
+    //---------------------------------------------------------------
+    // Fills a matrix ready to solve, from the input file, randomly or
+    // with the given boundary around an interior of zeros. Files are
+    // copied and random matrices filled on the context's threads.
+    //---------------------------------------------------------------
+    if (grid->inputPath != NULL){
+        struct gridHeader header;
+        double **input = openMatrixMapped(grid->inputPath, &header);
+        relax_context_copy(ctx, &input, m, grid->rows, grid->cols);
+        closeMatrixMapped(&input, &header);
+        return;
     }
-    else if (*type == 'c'){
-        printf("Type      = Correctness\n");
+    if (!grid->hasBoundary){
+        relax_context_fill(ctx, m, grid->rows, grid->cols, 0, 10, grid->seed);
+        return;
     }
 
-    else{
-        printf("Type      = Single\n");
+    for (int i=1; i<(grid->rows-1); i++){
+        memset((*m)[i], 0, grid->cols*sizeof(double));
     }
-
-    printf("\n");
+    struct dirichletBoundary boundary = createUniformBoundary(grid->rows,
+                                                              grid->cols,
+                                                              grid->top,
+                                                              grid->bottom,
+                                                              grid->left,
+                                                              grid->right);
+    applyBoundary(m, grid->rows, grid->cols, &boundary);
+    freeBoundary(&boundary);
 }
 
 
-struct assignedRows getAssignedRows(int scale, int threads){
-
-    struct assignedRows AR;
-
+int setVariant(struct relaxOptions *options, const char *name){
     //---------------------------------------------------------------
-    // Multi threading works in this program by dividing up the
-    // rows of the matrix, so there must be enough rows for each
-    // thread.
+    // Sets the method, or float or mixed jacobi, by name. Returns 0
+    // when the name is not one of them.
     //---------------------------------------------------------------
-    int workableRows = scale - 2;
-    if (threads > workableRows){
-        printf("Scale must be at least x+2 in size to work with x threads.\n");
-        exit(0);
+    options->dataType = DTYPE_DOUBLE;
+    if (strcmp(name, "jacobi") == 0){
+        options->method = METHOD_JACOBI;
+    }
+    else if (strcmp(name, "gs") == 0){
+        options->method = METHOD_GS;
+    }
+    else if (strcmp(name, "sor") == 0){
+        options->method = METHOD_SOR;
+    }
+    else if (strcmp(name, "multigrid") == 0){
+        options->method = METHOD_MULTIGRID;
     }
+    else if (strcmp(name, "float") == 0){
+        options->method = METHOD_JACOBI;
+        options->dataType = DTYPE_FLOAT;
+    }
+    else if (strcmp(name, "mixed") == 0){
+        options->method = METHOD_JACOBI;
+        options->dataType = DTYPE_MIXED;
+    }
+    else{
+        return 0;
+    }
+    return 1;
+}
 
 
-    AR.assignedNumberOfRows = malloc(threads*sizeof(int));
-    AR.assignedStartRow = malloc(threads*sizeof(int));
-    for (int i=0; i<threads; i++){
-        AR.assignedNumberOfRows[i] = 0;
+void getOption(struct relaxOptions *options, struct gridSetup *grid,
+               struct benchmarkSetup *bench, char *arg){
+    //---------------------------------------------------------------
+    // Reads one optional 'name=value' argument into the options
+    //---------------------------------------------------------------
+    char *value = strchr(arg, '=');
+    if (value == NULL){
+        printf("Option '%s' should be given as name=value.\n", arg);
+        exit(0);
     }
-
+    *value = '\0';
+    value++;
 
     //---------------------------------------------------------------
-    // Each thread is incrementally given rows until all number
-    // of rows are assigned.
+    // Solver options are read by the solver, the rest describe the
+    // grid and the benchmark.
     //---------------------------------------------------------------
-    int threadToIncrement = 0;
-    for (int i=0; i<workableRows; i++){
+    const char *problem = relax_set_option(options, arg, value);
+    if (problem == NULL){
+        return;
+    }
+    if (problem != RELAX_UNKNOWN_OPTION){
+        printf("%s\n", problem);
+        exit(0);
+    }
 
-        AR.assignedNumberOfRows[threadToIncrement]++;
-        
-        threadToIncrement++;
-        if (threadToIncrement >= threads){
-            threadToIncrement = 0;
+    if (strcmp(arg, "boundary") == 0){
+        if (sscanf(value, "%lf,%lf,%lf,%lf", &grid->top, &grid->bottom,
+                   &grid->left, &grid->right) != 4){
+            printf("Boundary must be given as top,bottom,left,right.\n");
+            exit(0);
+        }
+        grid->hasBoundary = 1;
+    }
+    else if (strcmp(arg, "reboundary") == 0){
+        if (sscanf(value, "%lf,%lf,%lf,%lf", &grid->reboundary[0],
+                   &grid->reboundary[1], &grid->reboundary[2],
+                   &grid->reboundary[3]) != 4){
+            printf("Reboundary must be given as top,bottom,left,right.\n");
+            exit(0);
         }
+        grid->hasReboundary = 1;
+    }
+    else if (strcmp(arg, "seed") == 0){
+        grid->seed = strtoul(value, NULL, 10);
     }
+    else if (strcmp(arg, "scales") == 0){
+        bench->scales = value;
+    }
+    else if (strcmp(arg, "threadlist") == 0){
+        bench->threads = value;
+    }
+    else if (strcmp(arg, "precisions") == 0){
+        bench->precisions = value;
+    }
+    else if (strcmp(arg, "variants") == 0){
+        bench->variants = value;
+    }
+    else if (strcmp(arg, "runs") == 0){
+        bench->runs = atoi(value);
+        if (bench->runs < 1){
+            printf("The benchmark needs at least 1 timed run.\n");
+            exit(0);
+        }
+    }
+    else if (strcmp(arg, "warmup") == 0){
+        bench->warmups = atoi(value);
+        if (bench->warmups < 0){
+            printf("Warm up runs can not be negative.\n");
+            exit(0);
+        }
+    }
+    else if (strcmp(arg, "csv") == 0){
+        bench->csvPath = value;
+    }
+    else if (strcmp(arg, "json") == 0){
+        bench->jsonPath = value;
+    }
+    else if (strcmp(arg, "batch") == 0){
+        grid->batchCount = atoi(value);
+        if (grid->batchCount < 1){
+            printf("A batch must have at least 1 grid.\n");
+            exit(0);
+        }
+    }
+    else if (strcmp(arg, "output") == 0){
+        grid->outputPath = value;
+    }
+    else if (strcmp(arg, "source") == 0){
+        grid->sourceSpec = value;
+    }
+    else if (strcmp(arg, "coefficients") == 0){
+        grid->coefficientSpec = value;
+    }
+    else if (strcmp(arg, "mask") == 0){
+        grid->maskPath = value;
+    }
+    else{
+        printf("Unknown option '%s'.\n", arg);
+        exit(0);
+    }
+}
 
 
+double **loadField(const char *spec, struct gridSetup *grid,
+                   const char *name){
     //---------------------------------------------------------------
-    // The row each thread is to start from is assigned.
-    // Each row will then have a start row, and a number of rows
-    // to work in. So the range can then be worked out.
+    // A matrix of the grid's shape holding spec, either a number for
+    // every cell or the path of a grid file of the same shape.
     //---------------------------------------------------------------
-    int startRow = 1;
-    for (int i=0; i<threads; i++){
-        AR.assignedStartRow[i] = startRow;
-        startRow = startRow + AR.assignedNumberOfRows[i];
+    double **field = createMatrix(grid->rows, grid->cols);
+    char *end;
+    double constant = strtod(spec, &end);
+    if (end != spec && *end == '\0'){
+        for (int i=0; i<grid->rows; i++){
+            for (int j=0; j<grid->cols; j++){
+                field[i][j] = constant;
+            }
+        }
+        return field;
     }
 
-    return AR;
+    struct gridHeader header;
+    readGridHeader(spec, &header);
+    if (header.rows != grid->rows || header.cols != grid->cols){
+        printf("The %s file %s is %d x %d, not %d x %d.\n", name, spec,
+               (int)header.rows, (int)header.cols, grid->rows, grid->cols);
+        exit(0);
+    }
+    double **input = openMatrixMapped(spec, &header);
+    copyMatrix(&input, &field, grid->rows, grid->cols);
+    closeMatrixMapped(&input, &header);
+    return field;
 }
 
 
-int allTrue(int **array, int size){
+void setupProblem(struct gridSetup *grid, struct relaxOptions *options){
     //---------------------------------------------------------------
-    // Checks all values in an array are 1;
+    // Builds the equation the source and coefficients describe, which
+    // falls back to Poisson's or Laplace's when they allow, and hands
+    // it to the solver.
     //---------------------------------------------------------------
-    for (int i=0; i<size; i++){
-        if ((*array)[i] == 0){
-            return 0;
-        }
+    double **source = NULL;
+    if (grid->sourceSpec != NULL){
+        source = loadField(grid->sourceSpec, grid, "source");
     }
-    return 1;
-}
 
+    const char *comma = NULL;
+    if (grid->coefficientSpec != NULL){
+        comma = strchr(grid->coefficientSpec, ',');
+    }
+    if (comma != NULL){
+        char *northPath = strndup(grid->coefficientSpec,
+                                  comma - grid->coefficientSpec);
+        double **north = loadField(northPath, grid, "north coefficient");
+        double **west = loadField(comma + 1, grid, "west coefficient");
+        grid->problem = variableProblemFromEdges(&north, &west,
+                                                 source == NULL ? NULL :
+                                                 &source,
+                                                 grid->rows, grid->cols);
+        freeMatrix(&north);
+        freeMatrix(&west);
+        free(northPath);
+    }
+    else {
+        double **coefficients;
+        if (grid->coefficientSpec != NULL){
+            coefficients = loadField(grid->coefficientSpec, grid,
+                                     "coefficient");
+        }
+        else {
+            coefficients = loadField("1", grid, "coefficient");
+        }
+        grid->problem = variableProblemFromCells(&coefficients,
+                                                 source == NULL ? NULL :
+                                                 &source,
+                                                 grid->rows, grid->cols);
+        freeMatrix(&coefficients);
+    }
 
-void relax_sync(double*** matrix, int scale, double precision, int verbose){
+    if (source != NULL){
+        freeMatrix(&source);
+    }
+    options->problem = &grid->problem;
+}
 
-    printf("Starting relaxation of %d x %d ", scale, scale);
-    printf("matrix with check function to precision %f\n", precision);
 
+void setupMask(struct gridSetup *grid, struct relaxOptions *options){
     //---------------------------------------------------------------
-    // Create second matrix to hold the previous value for comparison
+    // Reads the cells held fixed and hands the mask to the solver
     //---------------------------------------------------------------
-    double **lastMatrix = cloneMatrix(matrix, scale);
+    double **fixed = loadField(grid->maskPath, grid, "mask");
+    grid->mask = createCellMask(&fixed, grid->rows, grid->cols);
+    freeMatrix(&fixed);
+    if (grid->mask.active == 0){
+        printf("The mask leaves no cells to relax.\n");
+        exit(0);
+    }
+    options->mask = &grid->mask;
+}
 
 
+void checkOptions(struct relaxOptions *options){
     //---------------------------------------------------------------
-    // Iterativley relax matrix until the difference is less than
-    // the precision.
+    // Exits if the options ask for things that do not work together
     //---------------------------------------------------------------
-    int count = 0;
-    do {
-        if (verbose){
-            printf("Matrix after %d step/s\n", count);
-            printMatrix(matrix, scale);
-        }
-
-        swapMatrix(matrix, &lastMatrix);
-
-        relaxMatrix(&lastMatrix, matrix, scale);
-        
-        count++;
-
-    } while (!sameMatrixToPrecision(matrix, &lastMatrix, scale, precision));
-
-
-
-    printf("Finished in %d step/s\n", count);
-    if (verbose){
-        printf("Final Matrix\n");
-        printMatrix(matrix, scale);
-        printf("\n");
+    const char *problem = relax_options_problem(options);
+    if (problem != NULL){
+        printf("%s\n", problem);
+        exit(0);
     }
-    
-
-    free(lastMatrix);
 }
 
 
-void relax_rows(double ***matrix, double ***lastMatrix, int **rowsComplete,
-                int scale,        int rowFrom,          int rowTo, 
-                double precision, int threadNumber,     int totalThreads){
-
-
-    int count = 0;
-    while (1){
-
-        if (threadNumber == 0){
-            //printf("Matrix after %d step/s\n", count);
-            //printMatrix(matrix, scale);
-
-            swapMatrix(matrix, lastMatrix);
-        }
-
-  
-        pthread_barrier_wait(&barrier);
-
-        //printf("Thread %d relaxing its rows\n", threadNumber);
-        relaxMatrixRows(lastMatrix, matrix, scale, rowFrom, rowTo);
-        count++;
-
+void getArgs(struct gridSetup *grid, int *threads, 
+             double* precision,      char *type, 
+             struct relaxOptions *options,
+             struct benchmarkSetup *bench,
+             int argc,               char* argv[]){
 
-        if ( ((*rowsComplete)[threadNumber] == 0) &&
-             (sameMatrixRowsToPrecision(lastMatrix, matrix, scale,
-                                      precision, rowFrom, rowTo))) {
+    printf("\n");
+    
+    //---------------------------------------------------------------
+    // Check the correct amount of arguments are given
+    //---------------------------------------------------------------
+    if (argc < 5){
+        printf("Not enough arguments, please provide arguments for");
+        printf(" 'Scale', 'Threads', 'Precision', and 'Type'.\n");
+        exit(0);
+    }
 
-            (*rowsComplete)[threadNumber] = 1;
-        }
 
-        pthread_barrier_wait(&barrier);
-        
-        
-        if (allTrue(rowsComplete, totalThreads)){
-            //printf("Thread %d found all to be correct now\n", threadNumber);
-            pthread_barrier_wait(&barrier);
-            break;        
+    //---------------------------------------------------------------
+    // Collect arguments and put them into the addresses given
+    //---------------------------------------------------------------
+    // The scale is either a single size for a square matrix,
+    // rowsxcols, eg 200x50000, planesxrowsxcols for a volume, eg
+    // 200x200x200, or a grid file to start from.
+    //---------------------------------------------------------------
+    struct gridHeader header;
+    grid->rows = 0;
+    grid->cols = 0;
+    grid->hasBoundary = 0;
+    grid->inputPath = NULL;
+    grid->outputPath = NULL;
+    grid->hasReboundary = 0;
+    grid->batchCount = 1000;
+    grid->seed = 1;
+    grid->sourceSpec = NULL;
+    grid->coefficientSpec = NULL;
+    grid->problem = laplaceProblem(0, 0);
+    grid->maskPath = NULL;
+    memset(bench, 0, sizeof(struct benchmarkSetup));
+    bench->runs = 5;
+    bench->warmups = 1;
+
+    grid->planes = 0;
+    int sizes = sscanf(argv[1], "%dx%dx%d", &grid->planes, &grid->rows,
+                       &grid->cols);
+    if (sizes == 3){
+        if (grid->planes < 3){
+            printf("The volume must be at least 3x3x3 to have an interior.\n");
+            exit(0);
         }
     }
-
-    pthread_barrier_wait(&barrier);
-
-    if (threadNumber == 0){
-        printf("Matrix finished after %d steps!\n", count);
-        //printf("Final matrix\n");
-        //printMatrix(matrix, scale);
+    else{
+        grid->planes = 0;
+        sizes = sscanf(argv[1], "%dx%d", &grid->rows, &grid->cols);
     }
-}
-
+    if (sizes == 1){
+        grid->cols = grid->rows;
+    }
+    else if (sizes < 1){
+        grid->inputPath = argv[1];
+        readGridHeader(grid->inputPath, &header);
+        grid->rows = (int)header.rows;
+        grid->cols = (int)header.cols;
+        grid->hasBoundary = header.hasBoundary;
+        grid->top = header.boundary[0];
+        grid->bottom = header.boundary[1];
+        grid->left = header.boundary[2];
+        grid->right = header.boundary[3];
+    }
+    *threads = atoi(argv[2]);
+    sscanf(argv[3], "%lf", precision);
+    *type = argv[4][0];
 
-void *relax_rows_thread(void *payload){
     //---------------------------------------------------------------
-    // Runs  'relax_rows' function in a seperate thread.
+    // Anything after the four required arguments is an option
     //---------------------------------------------------------------
-    struct thread_args *p = payload;  
-    relax_rows((*p).matrix, 
-               (*p).lastMatrix,
-               (*p).rowsComplete,
-               (*p).scale, 
-               (*p).rowFrom, 
-               (*p).rowTo, 
-               (*p).precision, 
-               (*p).threadNumber, 
-               (*p).totalThreads);
-
-    return payload;
-}
-
-
-void relax_async(double ***matrix, int scale, int threads, double precision){
-
-    printf("Starting relaxation of %d x %d ", scale, scale);
-    printf("matrix with %d threads to precision %f\n", threads, precision);
+    *options = relax_default_options();
+    selectRelaxKernel(KERNEL_AUTO);
+    for (int i=5; i<argc; i++){
+        getOption(options, grid, bench, argv[i]);
+    }
 
     //---------------------------------------------------------------
-    // Collect data on which thread will work on which rows.
+    // A checkpoint is a grid file part way through a solve, starting
+    // from one carries on its count of sweeps.
     //---------------------------------------------------------------
-    struct assignedRows AR = getAssignedRows(scale, threads);
+    if (grid->inputPath != NULL){
+        options->sweepsBefore = header.sweeps;
+    }
+    checkOptions(options);
 
-    //---------------------------------------------------------------
-    // Create array of argument structs to hold arguments for each
-    // thread.
-    //---------------------------------------------------------------
-    struct thread_args *p = malloc(threads*sizeof(struct thread_args));
+    if (*type == 'b' && options->checkpointPath != NULL){
+        printf("Checkpoints are not written in batch mode.\n");
+        exit(0);
+    }
 
-    pthread_t *ptt = malloc((threads-1)*sizeof(pthread_t));
-    pthread_barrier_init(&barrier, NULL, threads);
+    if (grid->rows < 3 || grid->cols < 3){
+        printf("The matrix must be at least 3x3 to have an interior.\n");
+        exit(0);
+    }
 
+    if (*threads < 1){
+        printf("You cannot run on less than 1 thread.\n");
+        printf("Exiting\n");
+        exit(0);
+    }
 
+    if (grid->sourceSpec != NULL || grid->coefficientSpec != NULL){
+        if (grid->planes > 0 || *type == 't' || *type == 'b'){
+            printf("Sources and coefficients only work on matrices in 'Single' and 'Correctness' modes.\n");
+            exit(0);
+        }
+        setupProblem(grid, options);
+        checkOptions(options);
+    }
 
-    int *rowsComplete = malloc(threads*sizeof(int));
-    for (int i=0; i<threads; i++){
-        rowsComplete[i] = 0;
+    if (grid->maskPath != NULL){
+        if (grid->planes > 0 || *type == 't' || *type == 'b'){
+            printf("Masks only work on matrices in 'Single' and 'Correctness' modes.\n");
+            exit(0);
+        }
+        setupMask(grid, options);
+        checkOptions(options);
     }
 
-    //---------------------------------------------------------------
-    // Create second matrix to hold previous value for comparison
-    //---------------------------------------------------------------
-    double **lastMatrix = cloneMatrix(matrix, scale);
+    if (grid->planes > 0){
+        const char *problem = relax_volume_options_problem(options);
+        if (problem != NULL){
+            printf("%s\n", problem);
+            exit(0);
+        }
+        if (*type == 't' || *type == 'b'){
+            printf("Volumes only run in 'Single' and 'Correctness' modes.\n");
+            exit(0);
+        }
+        if (grid->hasBoundary || grid->hasReboundary ||
+            grid->outputPath != NULL){
+            printf("Volumes start random and are not written to grid files.\n");
+            exit(0);
+        }
+        int planeParts, rowParts;
+        volumeDecompose(grid->planes, grid->rows, *threads, &planeParts,
+                        &rowParts);
+        if (planeParts == 0){
+            printf("Volume can not be split into a block with a plane and a row for each of %d threads.\n",
+                   *threads);
+            exit(0);
+        }
+    }
 
 
     //---------------------------------------------------------------
-    // Create each thread with the arguments telling it the addresses
-    // of the matrices to work on, and the rows it is designated to
-    // work with within that matrix.
+    // Print arguments
     //---------------------------------------------------------------
-    for (int i=0; i<threads; i++){
-
-        //---------------------------------------------------------------
-        // Fill struct with arguments specified for each thread
-        //---------------------------------------------------------------
-        p[i].matrix = matrix;
-        p[i].lastMatrix = &lastMatrix;
-        p[i].rowsComplete = &rowsComplete;
-        p[i].scale = scale;
-        p[i].rowFrom = AR.assignedStartRow[i];
-        p[i].rowTo = AR.assignedStartRow[i] + AR.assignedNumberOfRows[i] - 1;
-        p[i].precision = precision;
-        p[i].threadNumber = i;
-        p[i].totalThreads = threads;
 
-        
-
-        //---------------------------------------------------------------
-        // A new thread is created and run for n threads specified, the 
-        // last thread is run by *this* thread to avoid having n+1
-        // threads running.
-        //---------------------------------------------------------------
-        if (i == (threads-1)){
-            relax_rows(p[i].matrix,
-                       p[i].lastMatrix,
-                       p[i].rowsComplete,
-                       p[i].scale,
-                       p[i].rowFrom,
-                       p[i].rowTo,
-                       p[i].precision,
-                       p[i].threadNumber,
-                       p[i].totalThreads);
+    printf("Arguments set as...\n");
+    if (grid->planes > 0){
+        printf("Scale     = %d x %d x %d, 7 point stencil on %dx%d tiles\n",
+               grid->planes, grid->rows, grid->cols, options->volumeTileRows,
+               options->volumeTileCols);
+    }
+    else{
+        printf("Scale     = %d x %d\n", grid->rows, grid->cols);
+    }
+    if (grid->inputPath != NULL){
+        printf("Input     = %s", grid->inputPath);
+        if (options->sweepsBefore > 0){
+            printf(", resuming after %ld sweep/s", options->sweepsBefore);
         }
-        else{
-            pthread_create(&ptt[i], NULL, &relax_rows_thread, &(p[i]));
+        printf("\n");
+    }
+    if (grid->hasBoundary){
+        printf("Boundary  = top %f, bottom %f, left %f, right %f\n",
+               grid->top, grid->bottom, grid->left, grid->right);
+    }
+    if (options->checkpointPath != NULL){
+        printf("Checkpoint= %s every %d sweep/s\n", options->checkpointPath,
+               options->checkpointEvery);
+    }
+    if (grid->hasReboundary){
+        printf("Re-solve  = top %f, bottom %f, left %f, right %f, %s\n",
+               grid->reboundary[0], grid->reboundary[1],
+               grid->reboundary[2], grid->reboundary[3],
+               options->incremental ? "moving rows only" : "whole matrix");
+    }
+    if (grid->problem.kind != PROBLEM_LAPLACE){
+        printf("Problem   = %s\n", grid->problem.kind == PROBLEM_POISSON ?
+               "Poisson, constant coefficient" :
+               "Variable coefficients");
+    }
+    if (grid->maskPath != NULL){
+        printf("Mask      = %s, %ld of %ld interior cells active\n",
+               grid->maskPath, grid->mask.active,
+               (long)(grid->rows-2)*(grid->cols-2));
+    }
+    printf("Seed      = %u\n", grid->seed);
+    printf("Threads   = %d\n", *threads);
+    printf("Precision = %f\n", *precision);
+    printf("Kernel    = %s\n", relaxKernelName(relaxKernel));
+    if (options->dataType != DTYPE_DOUBLE){
+        printf("Data type = %s\n", options->dataType == DTYPE_FLOAT ?
+               "Float" : "Float sweeps then double");
+    }
+    if (options->profile || options->tracePath != NULL){
+        printf("Profile   = Phase times per thread%s%s\n",
+               options->tracePath != NULL ? ", trace to " : "",
+               options->tracePath != NULL ? options->tracePath : "");
+    }
+    if (relaxStopsEarly(options) || options->historyPath != NULL){
+        const char *rules[] = {"Largest change", "RMS change",
+                               "Largest change relative to largest value"};
+        printf("Stop      = %s", rules[options->stopRule]);
+        if (options->maxSweeps > 0){
+            printf(", at most %d sweep/s", options->maxSweeps);
+        }
+        if (options->maxSeconds > 0.0){
+            printf(", at most %f s", options->maxSeconds);
+        }
+        if (options->stagnationSweeps > 0){
+            printf(", stagnant after %d sweep/s", options->stagnationSweeps);
+        }
+        if (options->historyPath != NULL){
+            printf(", history to %s", options->historyPath);
         }
+        printf("\n");
+    }
+    if (options->numa || options->hugePages || options->cpuList != NULL){
+        printf("Memory    = %s first touch, %s pages, cpus %s\n",
+               options->numa ? "Per thread" : "Main thread",
+               options->hugePages ? "huge" : "normal",
+               options->cpuList != NULL ? options->cpuList : "unpinned");
+    }
+
+    if (options->method == METHOD_MULTIGRID){
+        printf("Method    = Multigrid %s cycles, %d smoothing sweep/s\n",
+               options->cycle == CYCLE_F ? "F" : "V", options->smoothing);
+    }
+    else if (options->method == METHOD_SOR){
+        printf("Method    = SOR, omega %f\n", relaxOmega(options, grid->rows,
+                                                     grid->cols));
+    }
+    else if (options->method == METHOD_GS){
+        printf("Method    = Red black Gauss Seidel\n");
+    }
+    else{
+        printf("Method    = Jacobi\n");
+    }
 
+    if (options->temporalDepth > 0){
+        printf("Blocking  = %d sweeps on %dx%d tiles\n",
+               options->temporalDepth, options->tileRows, options->tileCols);
+    }
+    else if (options->exchange == EXCHANGE_HALO){
+        printf("Exchange  = Halo, %d ghost row/s, checked every %d sweep/s\n",
+               options->ghostDepth, options->ghostDepth);
+    }
+    else if (options->schedule == SCHEDULE_STEAL){
+        printf("Schedule  = Steal chunks of %d row/s, checked every %d sweep/s\n",
+               options->chunkRows, options->checkEvery);
+    }
+    else if (options->convergence == CONVERGE_REDUCE){
+        printf("Converge  = Reduce, checked every %d sweep/s\n",
+               options->checkEvery);
+    }
+    else if (options->convergence == CONVERGE_ASYNC){
+        printf("Converge  = Asynchronous, no barriers\n");
+    }
+    else{
+        printf("Converge  = Flags\n");
     }
 
-    for (int i=0; i<(threads-1); i++){
-        pthread_join(ptt[i], NULL);
+    if (*type == 't'){
+        printf("Type      = Test, %d warm up and %d timed run/s of each setting\n",
+               bench->warmups, bench->runs);
+    }
+    else if (*type == 'c'){
+        printf("Type      = Correctness\n");
+    }
+    else if (*type == 'b'){
+        printf("Type      = Batch of %d grids\n", grid->batchCount);
     }
 
-    pthread_barrier_destroy(&barrier);
-    free(lastMatrix);
+    else{
+        printf("Type      = Single\n");
+    }
+
+    printf("\n");
 }
 
 
-void test_correctness(int scale, double precision, int threads){
+void test_correctness(struct gridSetup *grid, double precision, int threads,
+                      struct relaxOptions *options){
     struct timespec start, finish;
+    int rows = grid->rows;
+    int cols = grid->cols;
 
     //--------------------------------------------------------------------
-    // Create original matrix to begin from
+    // Create original matrix to begin from. Setting up, copying and
+    // checking matrices is shared between one pool of every thread, so
+    // only the solves run on fewer.
     //--------------------------------------------------------------------
-    double **originalMatrix = createMatrix(scale);
-    fillMatrix(&originalMatrix, scale, 0, 10);
+    struct relaxContext *setup = relax_context_create(threads);
+    setup->quiet = 1;
+    double **originalMatrix = createMatrix(rows, cols);
+    setupMatrix(setup, &originalMatrix, grid);
 
 
 
     //--------------------------------------------------------------------
     // Use the 'check' function to generate the 'right' answer
     //--------------------------------------------------------------------
-    double **correctMatrix = cloneMatrix(&originalMatrix, scale);;
+    double **correctMatrix = relax_context_clone(setup, &originalMatrix,
+                                                 rows, cols);
 
+    int checkEvery = relaxCheckInterval(options, rows, cols, 1);
     clock_gettime(CLOCK_MONOTONIC, &start);
-    relax_sync(&correctMatrix, scale, precision, 0);
+    struct relaxResult correctResult = relax_sync(&correctMatrix, rows, cols,
+                                                  precision, 0, options, 1);
     clock_gettime(CLOCK_MONOTONIC, &finish);
 
     double time_answer_seconds = (finish.tv_sec - start.tv_sec);
@@ -395,7 +740,7 @@ void test_correctness(int scale, double precision, int threads){
     // Run the multi thread function for each number of threads up to 
     // given amount, and time how long each takes
     //--------------------------------------------------------------------
-    double **workingMatrix = createMatrix(scale);
+    double **workingMatrix = createMatrix(rows, cols);
     double *time_seconds = malloc(threads * sizeof(double));
     
 
@@ -404,32 +749,77 @@ void test_correctness(int scale, double precision, int threads){
     for (int i=0; i<threads; i++){
         printf("-------------------------------------------------------\n");
 
+        //-----------------------------------------------------------------
+        // Ghost rows are cut to the fewest rows any thread has, so with
+        // more threads convergence may be tested on other sweeps. The
+        // check function is run again to test on the same ones.
+        //-----------------------------------------------------------------
+        int interval = relaxCheckInterval(options, rows, cols, i+1);
+        if (interval != checkEvery){
+            printf("%d threads check every %d sweep/s, re-running the check function\n",
+                   i+1, interval);
+            relax_context_copy(setup, &originalMatrix, &correctMatrix,
+                               rows, cols);
+            correctResult = relax_sync(&correctMatrix, rows, cols, precision,
+                                       0, options, i+1);
+            checkEvery = interval;
+        }
+
+            struct relaxContext *ctx = relax_context_create(i+1);
+            ctx->options = *options;
+            describeGrid(&ctx->checkpointHeader, grid);
 
-            copyMatrix(&originalMatrix, &workingMatrix, scale);
+            relax_context_copy(setup, &originalMatrix, &workingMatrix,
+                               rows, cols);
 
             clock_gettime(CLOCK_MONOTONIC, &start);
-            relax_async(&workingMatrix, scale, i+1, precision);
+            struct relaxResult result = relax_context_solve(ctx, &workingMatrix,
+                                                            rows, cols,
+                                                            precision);
             clock_gettime(CLOCK_MONOTONIC, &finish);
 
+            relax_context_destroy(ctx);
+
             time_seconds[i] = (finish.tv_sec - start.tv_sec);
             time_seconds[i] += ((finish.tv_nsec - start.tv_nsec) / 1000000000.0);
 
 
 
+        //-----------------------------------------------------------------
+        // Asynchronous answers depend on how the threads happened to
+        // interleave, so they are only measured against the 'correct'
+        // answer rather than checked.
+        //-----------------------------------------------------------------
+        if (options->convergence == CONVERGE_ASYNC){
+            printf("Matrix differs from the correct answer by at most %e ",
+                   relax_context_max_difference(setup, &workingMatrix,
+                                                &correctMatrix, rows, cols));
+            printf("after %d sweep/s, the check function took %d\n",
+                   result.sweeps, correctResult.sweeps);
+            continue;
+        }
+
+
         //-----------------------------------------------------------------
         // Check each answer computed is the same as the 'correct' answer
         //-----------------------------------------------------------------
-        if (sameMatrix(&workingMatrix, &correctMatrix, scale)){
+        if (result.sweeps != correctResult.sweeps){
+            printf("ERROR! Matrix took %d step/s but should take %d!\n",
+                   result.sweeps, correctResult.sweeps);
+            exit(0);
+        }
+        if (relax_context_same(setup, &workingMatrix, &correctMatrix,
+                               rows, cols, 0.0)){
             printf("Matrix checked and is correct\n");
         }
         else{
             printf("ERROR! Matrix has been checked and is not correct!\n");
 
-            if (scale <= 20){
+            if (rows <= 20 && cols <= 20){
                 printf("This matrix\n");
-                printMatrix(&workingMatrix, scale);
+                printMatrix(&workingMatrix, rows, cols);
                 printf("Correct Matrix\n");
-                printMatrix(&correctMatrix, scale);
+                printMatrix(&correctMatrix, rows, cols);
             }
             exit(0);
         }
@@ -448,107 +838,497 @@ void test_correctness(int scale, double precision, int threads){
     for (int i=0; i<threads; i++){
         printf("%d thread: \t%.3f seconds\n", i+1, time_seconds[i]);
     }
+
+    freeMatrix(&originalMatrix);
+    freeMatrix(&correctMatrix);
+    freeMatrix(&workingMatrix);
+    free(time_seconds);
+    relax_context_destroy(setup);
 }
 
 
-void test_scale(int scale, double precision, int threads, int iterations){
-    struct timespec start, finish;
+const char *variantName(struct relaxOptions *options){
+    if (options->dataType == DTYPE_FLOAT){
+        return "float";
+    }
+    if (options->dataType == DTYPE_MIXED){
+        return "mixed";
+    }
+    if (options->method == METHOD_GS){
+        return "gs";
+    }
+    if (options->method == METHOD_SOR){
+        return "sor";
+    }
+    if (options->method == METHOD_MULTIGRID){
+        return "multigrid";
+    }
+    return "jacobi";
+}
 
 
-    double **time_seconds = malloc(threads * sizeof(double*));
-    for (int i=0; i<threads; i++){
-        time_seconds[i] = malloc(iterations*sizeof(double));
+char **splitList(const char *list, int *count){
+    //---------------------------------------------------------------
+    // Splits a comma separated list into its items, free each item
+    // and then the array.
+    //---------------------------------------------------------------
+    char *copy = strdup(list);
+    char **items = malloc((strlen(list)/2 + 1)*sizeof(char*));
+    char *save;
+
+    *count = 0;
+    for (char *item = strtok_r(copy, ",", &save); item != NULL;
+         item = strtok_r(NULL, ",", &save)){
+        items[(*count)++] = strdup(item);
     }
+    free(copy);
+    return items;
+}
 
-    //--------------------------------------------------------------------
-    // Create original matrix to begin from and working matrix
-    //--------------------------------------------------------------------
-    double **originalMatrix = createMatrix(scale);
-    double **workingMatrix = createMatrix(scale);
 
+void freeList(char **items, int count){
+    for (int i=0; i<count; i++){
+        free(items[i]);
+    }
+    free(items);
+}
 
-    for (int j=0; j<iterations; j++){
-        printf("-------------------------------------------------------\n");
 
-        fillMatrix(&originalMatrix, scale, 0, 10);
-        
+int compareSeconds(const void *a, const void *b){
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
 
-        for (int i=0; i<threads; i++){
 
+double bytesPerUpdate(struct relaxOptions *options){
+    //---------------------------------------------------------------
+    // The least memory traffic a sweep needs per cell, which the
+    // GB/s figure is worked out from. Jacobi reads the old matrix and
+    // writes the new one, red black sweeps read and write the matrix
+    // once for each colour, and floats are half the size. Mixed is
+    // counted as doubles, multigrid as its sweeps of the finest grid,
+    // and temporal blocking as though it were not tiled.
+    //---------------------------------------------------------------
+    if (options->method != METHOD_JACOBI){
+        return 4*sizeof(double);
+    }
+    if (options->dataType == DTYPE_FLOAT){
+        return 2*sizeof(float);
+    }
+    return 2*sizeof(double);
+}
 
-                copyMatrix(&originalMatrix, &workingMatrix, scale);
 
-                clock_gettime(CLOCK_MONOTONIC, &start);
-                relax_async(&workingMatrix, scale, i+1, precision);
-                clock_gettime(CLOCK_MONOTONIC, &finish);
+void writeBenchmarkCsv(const char *path, struct benchmarkResult *results,
+                       int count, struct gridSetup *grid){
+    FILE *file = fopen(path, "w");
+    if (file == NULL){
+        printf("Could not write '%s'.\n", path);
+        exit(0);
+    }
+    fprintf(file, "build,kernel,seed,rows,cols,threads,precision,variant,"
+                  "sweeps,median_s,p95_s,sweeps_per_s,glups,gbps\n");
+    for (int i=0; i<count; i++){
+        struct benchmarkResult *r = &results[i];
+        fprintf(file, "%s %s,%s,%u,%d,%d,%d,%g,%s,%d,%.6f,%.6f,%.1f,%.4f,%.3f\n",
+                __DATE__, __TIME__, relaxKernelName(relaxKernel), grid->seed,
+                r->rows, r->cols, r->threads, r->precision, r->variant,
+                r->sweeps, r->median, r->p95, r->sweepsPerSecond, r->glups,
+                r->gbps);
+    }
+    fclose(file);
+}
 
-                time_seconds[i][j] = (finish.tv_sec - start.tv_sec);
-                time_seconds[i][j] += ((finish.tv_nsec - start.tv_nsec) / 1000000000.0);
-        }
+
+void writeBenchmarkJson(const char *path, struct benchmarkResult *results,
+                        int count, struct gridSetup *grid,
+                        struct benchmarkSetup *bench){
+    FILE *file = fopen(path, "w");
+    if (file == NULL){
+        printf("Could not write '%s'.\n", path);
+        exit(0);
+    }
+    fprintf(file, "{\n  \"build\": \"%s %s\",\n", __DATE__, __TIME__);
+    fprintf(file, "  \"kernel\": \"%s\",\n", relaxKernelName(relaxKernel));
+    fprintf(file, "  \"seed\": %u,\n", grid->seed);
+    fprintf(file, "  \"warmups\": %d,\n", bench->warmups);
+    fprintf(file, "  \"runs\": %d,\n", bench->runs);
+    fprintf(file, "  \"results\": [\n");
+    for (int i=0; i<count; i++){
+        struct benchmarkResult *r = &results[i];
+        fprintf(file, "    {\"rows\": %d, \"cols\": %d, \"threads\": %d, "
+                      "\"precision\": %g, \"variant\": \"%s\", \"sweeps\": %d, "
+                      "\"median_s\": %.6f, \"p95_s\": %.6f, "
+                      "\"sweeps_per_s\": %.1f, \"glups\": %.4f, \"gbps\": %.3f}%s\n",
+                r->rows, r->cols, r->threads, r->precision, r->variant,
+                r->sweeps, r->median, r->p95, r->sweepsPerSecond, r->glups,
+                r->gbps, i < count-1 ? "," : "");
     }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+}
 
-    //---------------------------------------------------------------
-    // Print results
-    //---------------------------------------------------------------
-    printf("\nRESULTS - TIME (seconds) ------------------\n");
-    printf("- Threads ----- average -------------------\n");
-    printf("-------------------------------------------\n");
-    for (int i=0; i<threads; i++){
 
-        double av = 0;
-        for (int j=0; j<iterations; j++){
-            av = av + time_seconds[i][j];
+void test_benchmark(struct gridSetup *grid, double precision, int threads,
+                    struct relaxOptions *options,
+                    struct benchmarkSetup *bench){
+    struct timespec start, finish;
+
+    //--------------------------------------------------------------------
+    // Read the lists, each defaulting to the one value given
+    //--------------------------------------------------------------------
+    char defaultScale[32], defaultPrecision[32];
+    snprintf(defaultScale, sizeof(defaultScale), "%dx%d",
+             grid->rows, grid->cols);
+    snprintf(defaultPrecision, sizeof(defaultPrecision), "%.17g", precision);
+
+    int scaleCount, precisionCount, variantCount, threadCount;
+    char **scales = splitList(bench->scales != NULL ? bench->scales :
+                              defaultScale, &scaleCount);
+    char **precisions = splitList(bench->precisions != NULL ?
+                                  bench->precisions : defaultPrecision,
+                                  &precisionCount);
+    char **variants = splitList(bench->variants != NULL ? bench->variants :
+                                variantName(options), &variantCount);
+    int *threadList;
+    if (bench->threads != NULL){
+        char **items = splitList(bench->threads, &threadCount);
+        threadList = malloc(threadCount*sizeof(int));
+        for (int t=0; t<threadCount; t++){
+            threadList[t] = atoi(items[t]);
+        }
+        freeList(items, threadCount);
+    }
+    else{
+        threadCount = threads;
+        threadList = malloc(threadCount*sizeof(int));
+        for (int t=0; t<threadCount; t++){
+            threadList[t] = t+1;
+        }
+    }
+
+    if (bench->scales != NULL && grid->inputPath != NULL){
+        printf("A list of scales can not be used with an input file.\n");
+        exit(0);
+    }
+    int *scaleRows = malloc(scaleCount*sizeof(int));
+    int *scaleCols = malloc(scaleCount*sizeof(int));
+    for (int s=0; s<scaleCount; s++){
+        int sizes = sscanf(scales[s], "%dx%d", &scaleRows[s], &scaleCols[s]);
+        if (sizes == 1){
+            scaleCols[s] = scaleRows[s];
+        }
+        if (sizes < 1 || scaleRows[s] < 3 || scaleCols[s] < 3){
+            printf("Scale '%s' must be a size of at least 3.\n", scales[s]);
+            exit(0);
+        }
+    }
+    for (int t=0; t<threadCount; t++){
+        if (threadList[t] < 1){
+            printf("You cannot run on less than 1 thread.\n");
+            exit(0);
         }
-        av = av / iterations;
+    }
+    for (int v=0; v<variantCount; v++){
+        struct relaxOptions variant = *options;
+        if (!setVariant(&variant, variants[v])){
+            printf("Variant '%s' must be 'jacobi', 'gs', 'sor', 'multigrid', "
+                   "'float' or 'mixed'.\n", variants[v]);
+            exit(0);
+        }
+        checkOptions(&variant);
+    }
+
 
+    //--------------------------------------------------------------------
+    // Keep one pool per thread count alive for every setting, so only
+    // the solves themselves are timed, not thread start up.
+    //--------------------------------------------------------------------
+    struct relaxContext **contexts = malloc(threadCount *
+                                            sizeof(struct relaxContext*));
+    for (int t=0; t<threadCount; t++){
+        contexts[t] = relax_context_create(threadList[t]);
+        contexts[t]->quiet = 1;
+    }
 
-        printf("%d thread: \t%.3f ( ", i+1, av);
-        for (int j=0; j<iterations; j++){
-            printf("%.3f ", time_seconds[i][j]);
+    int total = scaleCount*precisionCount*variantCount*threadCount;
+    struct benchmarkResult *results = malloc(total*sizeof(struct benchmarkResult));
+    double *seconds = malloc(bench->runs*sizeof(double));
+    int count = 0;
+
+    printf("%-11s %7s %10s %-9s %8s %10s %10s %10s %8s %8s\n", "Scale",
+           "Threads", "Precision", "Variant", "Sweeps", "Median s", "P95 s",
+           "Sweeps/s", "GLUP/s", "GB/s");
+
+    for (int s=0; s<scaleCount; s++){
+        struct gridSetup shape = *grid;
+        shape.rows = scaleRows[s];
+        shape.cols = scaleCols[s];
+        int rows = shape.rows;
+        int cols = shape.cols;
+
+        double **originalMatrix = createMatrix(rows, cols);
+        double **workingMatrix = createMatrix(rows, cols);
+        setupMatrix(contexts[0], &originalMatrix, &shape);
+
+        for (int e=0; e<precisionCount; e++){
+            double settle = atof(precisions[e]);
+
+            for (int v=0; v<variantCount; v++){
+                struct relaxOptions variant = *options;
+                setVariant(&variant, variants[v]);
+
+                for (int t=0; t<threadCount; t++){
+                    struct relaxContext *ctx = contexts[t];
+                    ctx->options = variant;
+
+                    for (int w=0; w<bench->warmups; w++){
+                        relax_context_copy(ctx, &originalMatrix,
+                                           &workingMatrix, rows, cols);
+                        relax_context_solve(ctx, &workingMatrix, rows, cols,
+                                            settle);
+                    }
+
+                    struct relaxResult result = {0, 0.0, 0};
+                    for (int r=0; r<bench->runs; r++){
+                        relax_context_copy(ctx, &originalMatrix,
+                                           &workingMatrix, rows, cols);
+
+                        clock_gettime(CLOCK_MONOTONIC, &start);
+                        result = relax_context_solve(ctx, &workingMatrix,
+                                                     rows, cols, settle);
+                        clock_gettime(CLOCK_MONOTONIC, &finish);
+
+                        seconds[r] = (finish.tv_sec - start.tv_sec);
+                        seconds[r] += ((finish.tv_nsec - start.tv_nsec) / 1000000000.0);
+                    }
+
+                    //------------------------------------------------------------
+                    // Median and 95th percentile (nearest rank) of the runs
+                    //------------------------------------------------------------
+                    int runs = bench->runs;
+                    qsort(seconds, runs, sizeof(double), &compareSeconds);
+
+                    struct benchmarkResult *b = &results[count++];
+                    b->rows = rows;
+                    b->cols = cols;
+                    b->threads = threadList[t];
+                    b->precision = settle;
+                    snprintf(b->variant, sizeof(b->variant), "%s", variants[v]);
+                    b->sweeps = result.sweeps;
+                    b->median = runs % 2 ? seconds[runs/2] :
+                                (seconds[runs/2-1] + seconds[runs/2]) / 2;
+                    b->p95 = seconds[(int)ceil(0.95*runs) - 1];
+
+                    double updates = (double)result.sweeps*(rows-2)*(cols-2);
+                    b->sweepsPerSecond = result.sweeps / b->median;
+                    b->glups = updates / b->median / 1e9;
+                    b->gbps = updates * bytesPerUpdate(&variant) / b->median / 1e9;
+
+                    printf("%-11s %7d %10g %-9s %8d %10.4f %10.4f %10.1f %8.3f %8.2f\n",
+                           scales[s], b->threads, b->precision, b->variant,
+                           b->sweeps, b->median, b->p95, b->sweepsPerSecond,
+                           b->glups, b->gbps);
+                }
+            }
         }
-        printf(")\n");
+
+        freeMatrix(&originalMatrix);
+        freeMatrix(&workingMatrix);
     }
+    printf("\n");
 
+    if (bench->csvPath != NULL){
+        writeBenchmarkCsv(bench->csvPath, results, count, grid);
+    }
+    if (bench->jsonPath != NULL){
+        writeBenchmarkJson(bench->jsonPath, results, count, grid, bench);
+    }
 
+    for (int t=0; t<threadCount; t++){
+        relax_context_destroy(contexts[t]);
+    }
+    free(contexts);
+    free(results);
+    free(seconds);
+    free(threadList);
+    free(scaleRows);
+    free(scaleCols);
+    freeList(scales, scaleCount);
+    freeList(precisions, precisionCount);
+    freeList(variants, variantCount);
+}
 
-    printf("\nRESULTS - Speedup (times faster than 1 thread)--\n");
-    printf("- Threads ----- Average ------------------------\n");
-    printf("------------------------------------------------\n");
 
+void test_batch(struct gridSetup *grid, double precision, int threads,
+                struct relaxOptions *options){
+    struct timespec start, finish;
+    int rows = grid->rows;
+    int cols = grid->cols;
+    int count = grid->batchCount;
 
-    double **speedup = malloc(threads * sizeof(double*));
-    for (int i=0; i<threads; i++){
-        speedup[i] = malloc(iterations*sizeof(double));
+    //--------------------------------------------------------------------
+    // Make the batch, and a copy of every grid to solve one at a time
+    //--------------------------------------------------------------------
+    struct relaxContext *ctx = relax_context_create(threads);
+    ctx->options = *options;
+
+    struct relaxGrid *batch = malloc(count*sizeof(struct relaxGrid));
+    struct relaxGrid *single = malloc(count*sizeof(struct relaxGrid));
+    for (int g=0; g<count; g++){
+        batch[g].rows = rows;
+        batch[g].cols = cols;
+        struct gridSetup shape = *grid;
+        shape.seed = grid->seed + g;
+        batch[g].matrix = createMatrix(rows, cols);
+        setupMatrix(ctx, &batch[g].matrix, &shape);
+        single[g] = batch[g];
+        single[g].matrix = relax_context_clone(ctx, &batch[g].matrix,
+                                               rows, cols);
     }
 
-    for (int i=0; i<threads; i++){
-        for (int j=0; j<iterations; j++){
-            speedup[i][j] = time_seconds[0][j] / time_seconds[i][j];
-        }
+
+    //--------------------------------------------------------------------
+    // Time the batch, then the same grids each split across the threads
+    //--------------------------------------------------------------------
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int whole = relax_context_solve_batch(ctx, batch, count, precision);
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+
+    double batch_seconds = (finish.tv_sec - start.tv_sec);
+    batch_seconds += ((finish.tv_nsec - start.tv_nsec) / 1000000000.0);
+
+    ctx->quiet = 1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int g=0; g<count; g++){
+        single[g].result = relax_context_solve(ctx, &single[g].matrix,
+                                               rows, cols, precision);
     }
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+
+    double single_seconds = (finish.tv_sec - start.tv_sec);
+    single_seconds += ((finish.tv_nsec - start.tv_nsec) / 1000000000.0);
+
 
-    for (int i=0; i<threads; i++){
-        double av = 0;
-        for (int j=0; j<iterations; j++){
-            av = av + speedup[i][j];
-        }
-        av = av / iterations;
 
-        printf("%d threads: \t%.3f ( ", i+1, av);
-        for (int j=0; j<iterations; j++){
-            printf("%.3f ", speedup[i][j]);
+    //--------------------------------------------------------------------
+    // Check every grid of the batch against its one at a time answer
+    //--------------------------------------------------------------------
+    int wrong = 0;
+    for (int g=0; g<count; g++){
+        if (batch[g].result.sweeps != single[g].result.sweeps ||
+            !relax_context_same(ctx, &batch[g].matrix, &single[g].matrix,
+                                rows, cols, 0.0)){
+            wrong++;
         }
-        printf(")\n");
+        freeMatrix(&batch[g].matrix);
+        freeMatrix(&single[g].matrix);
     }
+    free(batch);
+    free(single);
+    relax_context_destroy(ctx);
 
 
-
+    //---------------------------------------------------------------
+    // Print results
+    //---------------------------------------------------------------
+    printf("%d of %d grids solved whole on one thread\n", whole, count);
+    if (wrong == 0){
+        printf("Batch checked and is correct\n");
+    }
+    else{
+        printf("ERROR! %d grid/s of the batch are not correct!\n", wrong);
+    }
+    printf("\nRESULTS-------------------------------\n");
+    printf("Batch:         \t%.3f seconds, %.1f grids/second\n",
+           batch_seconds, count / batch_seconds);
+    printf("One at a time: \t%.3f seconds, %.1f grids/second\n",
+           single_seconds, count / single_seconds);
     printf("\n");
 }
 
-void single_test(int scale, double precision, int threads){
-    double **matrix = createMatrix(scale);
-    fillMatrix(&matrix, scale, 0, 10);
+
+void check_resolve(struct relaxContext *ctx, double ***matrix,
+                   double ***full, int rows, int cols, double precision,
+                   struct relaxResult *incremental,
+                   struct boundaryChange *changes, int changeCount){
+
+    //---------------------------------------------------------------
+    // Re-solves the same edited grid over the whole matrix, and says
+    // how far the incremental answer is from it. Rows the window
+    // never reached keep what the first solve left, where a full
+    // re-solve goes on moving them by less than the precision a
+    // sweep, so the two only match to the bit when that was nothing.
+    // The check is that a full solve started from the incremental
+    // answer finds it settled on its first checked sweep, so it
+    // passes the test a full solve stops on. Neither overwrites the
+    // re-solve's trace or history.
+    //---------------------------------------------------------------
+    int quiet = ctx->quiet;
+    const char *tracePath = ctx->options.tracePath;
+    const char *historyPath = ctx->options.historyPath;
+    ctx->quiet = 1;
+    ctx->options.incremental = 0;
+    ctx->options.tracePath = NULL;
+    ctx->options.historyPath = NULL;
+    struct relaxResult result = relax_context_resolve(ctx, full, rows, cols,
+                                                      precision, changes,
+                                                      changeCount);
+    printf("Re-solve differs from a full re-solve by at most %e, ",
+           relax_context_max_difference(ctx, matrix, full, rows, cols));
+    printf("after %d sweep/s to its %d\n", incremental->sweeps,
+           result.sweeps);
+
+    relax_context_copy(ctx, matrix, full, rows, cols);
+    struct relaxResult settle = relax_context_solve(ctx, full, rows, cols,
+                                                    precision);
+    ctx->options.incremental = 1;
+    ctx->options.tracePath = tracePath;
+    ctx->options.historyPath = historyPath;
+    ctx->quiet = quiet;
+
+    int checkEvery = relaxCheckInterval(&ctx->options, rows, cols,
+                                        ctx->threads);
+    if (settle.sweeps <= checkEvery){
+        printf("Re-solve checked and is correct\n\n");
+    }
+    else{
+        printf("ERROR! A full solve from the re-solve took %d step/s to settle!\n",
+               settle.sweeps);
+        exit(0);
+    }
+}
+
+
+void single_test(struct gridSetup *grid, double precision, int threads,
+                 struct relaxOptions *options){
+    int rows = grid->rows;
+    int cols = grid->cols;
+    struct relaxContext *ctx = relax_context_create(threads);
+    ctx->options = *options;
+    describeGrid(&ctx->checkpointHeader, grid);
+
+    //--------------------------------------------------------------------
+    // With numa the matrix's rows are first touched by the threads that
+    // will relax them, filling it afterwards leaves the pages in place.
+    // Otherwise an input file is solved where it is mapped, so nothing
+    // is read up front.
+    //--------------------------------------------------------------------
+    double **matrix;
+    struct gridHeader inputHeader;
+    int mapped = (grid->inputPath != NULL && !options->numa);
+    if (mapped){
+        matrix = openMatrixMapped(grid->inputPath, &inputHeader);
+    }
+    else if (options->numa){
+        matrix = relax_context_create_matrix(ctx, rows, cols);
+        setupMatrix(ctx, &matrix, grid);
+    }
+    else{
+        matrix = createMatrix(rows, cols);
+        setupMatrix(ctx, &matrix, grid);
+    }
     
 
 
@@ -556,7 +1336,8 @@ void single_test(int scale, double precision, int threads){
     double elapsed;
 
     clock_gettime(CLOCK_MONOTONIC, &start);
-    relax_async(&matrix, scale, threads, precision);
+    struct relaxResult result = relax_context_solve(ctx, &matrix, rows, cols,
+                                                    precision);
     clock_gettime(CLOCK_MONOTONIC, &finish);
 
     elapsed = (finish.tv_sec - start.tv_sec);
@@ -564,29 +1345,187 @@ void single_test(int scale, double precision, int threads){
         
     printf("Time = %f\n\n", elapsed);
 
-    free(matrix);
+    //--------------------------------------------------------------------
+    // Move the boundary and re-solve from the answer just found
+    //--------------------------------------------------------------------
+    if (grid->hasReboundary){
+        grid->hasBoundary = 1;
+        grid->top = grid->reboundary[0];
+        grid->bottom = grid->reboundary[1];
+        grid->left = grid->reboundary[2];
+        grid->right = grid->reboundary[3];
+
+        struct dirichletBoundary boundary = createUniformBoundary(rows, cols,
+                                                                  grid->top,
+                                                                  grid->bottom,
+                                                                  grid->left,
+                                                                  grid->right);
+        int changeCount;
+        struct boundaryChange *changes = boundaryChangesFrom(&matrix, rows, cols,
+                                                             &boundary,
+                                                             &changeCount);
+        freeBoundary(&boundary);
+
+        double **full = NULL;
+        if (options->incremental){
+            full = relax_context_clone(ctx, &matrix, rows, cols);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        struct relaxResult again = relax_context_resolve(ctx, &matrix,
+                                                         rows, cols, precision,
+                                                         changes, changeCount);
+        clock_gettime(CLOCK_MONOTONIC, &finish);
+        result.sweeps += again.sweeps;
+        result.residual = again.residual;
+
+        elapsed = (finish.tv_sec - start.tv_sec);
+        elapsed += (finish.tv_nsec - start.tv_nsec) / 1000000000.0;
+        printf("Re-solve time = %f\n\n", elapsed);
+
+        if (full != NULL){
+            check_resolve(ctx, &matrix, &full, rows, cols, precision,
+                          &again, changes, changeCount);
+            freeMatrix(&full);
+        }
+        free(changes);
+    }
+
+    if (grid->outputPath != NULL){
+        struct gridHeader header;
+        initGridHeader(&header, rows, cols);
+        describeGrid(&header, grid);
+        header.sweeps = options->sweepsBefore + result.sweeps;
+        header.precision = precision;
+        header.residual = result.residual;
+        if (writeGridFile(grid->outputPath, &matrix, &header) != 0){
+            printf("Could not write output '%s'.\n", grid->outputPath);
+            exit(0);
+        }
+    }
+
+    if (mapped){
+        closeMatrixMapped(&matrix, &inputHeader);
+    }
+    else if (options->numa){
+        relax_context_free_matrix(&matrix, rows);
+    }
+    else{
+        freeMatrix(&matrix);
+    }
+    relax_context_destroy(ctx);
+}
+
+
+void test_volume(struct gridSetup *grid, double precision, int threads,
+                 struct relaxOptions *options, int checking){
+    struct timespec start, finish;
+
+    //--------------------------------------------------------------------
+    // Solve a random volume on the threads given, or when checking on
+    // every number of threads up to them, each against the check
+    // function's answer.
+    //--------------------------------------------------------------------
+    struct relaxContext *ctx = relax_context_create(threads);
+    ctx->options = *options;
+    struct volume original = volumeAlloc(grid->planes, grid->rows, grid->cols);
+    relax_context_fill_volume(ctx, &original, 0, 10, grid->seed);
+
+    struct volume correct = volumeEmpty();
+    struct relaxResult correctResult = {0, 0.0, 0, 0};
+    if (checking){
+        correct = volumeAlloc(grid->planes, grid->rows, grid->cols);
+        relax_context_copy_volume(ctx, &original, &correct);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        correctResult = relax_sync_volume(&correct, precision, options);
+        clock_gettime(CLOCK_MONOTONIC, &finish);
+        double elapsed = (finish.tv_sec - start.tv_sec);
+        elapsed += (finish.tv_nsec - start.tv_nsec) / 1000000000.0;
+        printf("Sync function: \t%.3f seconds\n", elapsed);
+    }
+
+    struct volume working = volumeAlloc(grid->planes, grid->rows, grid->cols);
+    for (int t=(checking ? 1 : threads); t<=threads; t++){
+        if (checking){
+            printf("-------------------------------------------------------\n");
+        }
+        struct relaxContext *solver = ctx;
+        if (t != threads){
+            solver = relax_context_create(t);
+            solver->options = *options;
+        }
+        relax_context_copy_volume(ctx, &original, &working);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        struct relaxResult result = relax_context_solve_volume(solver, &working,
+                                                               precision);
+        clock_gettime(CLOCK_MONOTONIC, &finish);
+        double elapsed = (finish.tv_sec - start.tv_sec);
+        elapsed += (finish.tv_nsec - start.tv_nsec) / 1000000000.0;
+        printf("Time = %f\n", elapsed);
+        if (solver != ctx){
+            relax_context_destroy(solver);
+        }
+
+        if (!checking){
+            continue;
+        }
+        if (result.sweeps != correctResult.sweeps){
+            printf("ERROR! Volume took %d step/s but should take %d!\n",
+                   result.sweeps, correctResult.sweeps);
+            exit(0);
+        }
+        if (relax_context_same_volume(ctx, &working, &correct, 0.0)){
+            printf("Volume checked and is correct\n");
+        }
+        else{
+            printf("ERROR! Volume has been checked and is not correct, ");
+            printf("it differs by up to %e!\n",
+                   relax_context_max_volume_difference(ctx, &working,
+                                                       &correct));
+            exit(0);
+        }
+    }
+    printf("\n");
+
+    volumeFree(&original);
+    volumeFree(&correct);
+    volumeFree(&working);
+    relax_context_destroy(ctx);
 }
 
 
 int main(int argc, char *argv[]) {
 
-    int scale;
+    struct gridSetup grid;
     int threads;
     double precision;
     char type;
-    getArgs(&scale, &threads, &precision, &type, argc, argv);
+    struct relaxOptions options;
+    struct benchmarkSetup bench;
+    getArgs(&grid, &threads, &precision, &type, &options, &bench, argc, argv);
 
 
-    if (type == 't'){
-        test_scale(scale, precision, threads, 3);
+    if (grid.planes > 0){
+        test_volume(&grid, precision, threads, &options, type == 'c');
+    }
+    else if (type == 't'){
+        test_benchmark(&grid, precision, threads, &options, &bench);
     }
     else if (type == 'c'){
-        test_correctness(scale, precision, threads);
+        test_correctness(&grid, precision, threads, &options);
+    }
+    else if (type == 'b'){
+        test_batch(&grid, precision, threads, &options);
     }
     else {
-        single_test(scale, precision, threads);
+        single_test(&grid, precision, threads, &options);
     }
 
+    freeProblem(&grid.problem);
+    if (grid.maskPath != NULL){
+        freeCellMask(&grid.mask);
+    }
     return 0;
 }
 
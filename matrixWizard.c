@@ -1,6 +1,19 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <float.h>
+#include <stdint.h>
+
+#include <sys/mman.h>
+
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
+//---------------------------------------------------------------
+// Matrix buffers start on this boundary, a cache line and the
+// width of an AVX-512 vector, and grid rows are padded to it.
+//---------------------------------------------------------------
+#define GRID_ALIGN 64
 
 
 
@@ -14,36 +27,109 @@ void swapMatrix(double*** a, double*** b){
 }
 
 
-double **createMatrix(int scale){
+double **createMatrix(int rows, int cols){
 	//---------------------------------------------------------------
     // Creates 2D array of doubles
     //---------------------------------------------------------------
-	double **matrix = malloc(scale*sizeof(double*));
+	double **matrix = malloc(rows*sizeof(double*));
 	if (matrix == NULL){
 		printf("matrix is null so exiting");
 		exit(0);
 	}
 
-	double *buf = malloc(scale*scale*sizeof(double));
-	if (buf == NULL){
+	double *buf;
+	if (posix_memalign((void **)&buf, GRID_ALIGN,
+	                   (size_t)rows*cols*sizeof(double)) != 0){
 		printf("Matrix buffer is null so exiting");
 		exit(0);
 	}
 
-	for (int i=0; i<scale; i++){
-		matrix[i] = buf + (scale*i);
+	for (int i=0; i<rows; i++){
+		matrix[i] = buf + ((size_t)cols*i);
 	}
 
 	return matrix;
 }
 
 
-void printMatrix(double*** matrix, int scale){
+size_t mappedMatrixBytes(int rows, int cols, int hugePages){
+	size_t bytes = (size_t)rows*cols*sizeof(double);
+	if (hugePages){
+		bytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+	}
+	return bytes;
+}
+
+
+double **createMatrixMapped(int rows, int cols, int hugePages){
+	//---------------------------------------------------------------
+    // Creates 2D array of doubles whose buffer is mapped straight
+    // from the kernel and not touched, so each page is placed on the
+    // NUMA node of the thread that first writes to it. With
+    // hugePages it asks for 2MB pages, falling back to asking for
+    // transparent huge pages if none are reserved. The row table has
+    // one more entry pointing at the end of the mapping, so it can be
+    // unmapped without knowing how it was asked for.
+    //---------------------------------------------------------------
+	double **matrix = malloc((rows+1)*sizeof(double*));
+	if (matrix == NULL){
+		printf("matrix is null so exiting");
+		exit(0);
+	}
+
+	size_t bytes = mappedMatrixBytes(rows, cols, hugePages);
+	void *buf = MAP_FAILED;
+	if (hugePages){
+		buf = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+		           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	}
+	if (buf == MAP_FAILED){
+		buf = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+		           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (buf != MAP_FAILED && hugePages){
+			madvise(buf, bytes, MADV_HUGEPAGE);
+		}
+	}
+	if (buf == MAP_FAILED){
+		printf("Matrix buffer is null so exiting");
+		exit(0);
+	}
+
+	for (int i=0; i<rows; i++){
+		matrix[i] = (double *)buf + ((size_t)cols*i);
+	}
+	matrix[rows] = (double *)((char *)buf + bytes);
+
+	return matrix;
+}
+
+
+void freeMatrixMapped(double*** matrix, int rows){
+	//---------------------------------------------------------------
+    // Frees a matrix made by createMatrixMapped
+    //---------------------------------------------------------------
+	munmap((*matrix)[0], (char *)(*matrix)[rows] - (char *)(*matrix)[0]);
+	free(*matrix);
+	*matrix = NULL;
+}
+
+
+void freeMatrix(double*** matrix){
+	//---------------------------------------------------------------
+    // Frees both the row table and the buffer made by createMatrix
+    //---------------------------------------------------------------
+	free((*matrix)[0]);
+	free(*matrix);
+	*matrix = NULL;
+}
+
+
+void printMatrix(double*** matrix, int rows, int cols){
 	//---------------------------------------------------------------
     // Given a 2d Array, prints its values in a table format.
     //---------------------------------------------------------------
-	for (int i=0; i<scale; i++){
-		for (int j=0; j<scale; j++){
+	for (int i=0; i<rows; i++){
+		for (int j=0; j<cols; j++){
 			printf("%.2f ", (*matrix)[i][j]);
 		}
 		printf("\n");
@@ -52,32 +138,39 @@ void printMatrix(double*** matrix, int scale){
 }
 
 
-int copyMatrix(double*** copyFrom, double*** copyTo, int scale){
+void copyMatrixRows(double*** copyFrom, double*** copyTo, int cols,
+                    int rowFrom,         int rowTo){
 	//---------------------------------------------------------------
-    // Copies the contents of one matrix to another
+    // Copies the given rows of one matrix to another
     //---------------------------------------------------------------
-	for (int i=0; i<scale; i++){
-		for (int j=0; j<scale; j++){
-			(*copyTo)[i][j] = (*copyFrom)[i][j];
-		}
+	for (int i=rowFrom; i<=rowTo; i++){
+		memcpy((*copyTo)[i], (*copyFrom)[i], cols*sizeof(double));
 	}
+}
+
+
+int copyMatrix(double*** copyFrom, double*** copyTo, int rows, int cols){
+	//---------------------------------------------------------------
+    // Copies the contents of one matrix to another
+    //---------------------------------------------------------------
+	copyMatrixRows(copyFrom, copyTo, cols, 0, rows-1);
 	return 0;
 }
 
 
-double** cloneMatrix(double*** clonedFrom, int scale){
+double** cloneMatrix(double*** clonedFrom, int rows, int cols){
 	//---------------------------------------------------------------
     // Creates a new matrix with the same values as a given matrix
     //---------------------------------------------------------------
-	double** clonedTo = createMatrix(scale);
+	double** clonedTo = createMatrix(rows, cols);
 
-	copyMatrix(clonedFrom, &clonedTo, scale);
+	copyMatrix(clonedFrom, &clonedTo, rows, cols);
 
 	return clonedTo;
 }
 
 
-void relaxMatrixRows(double ***read, double*** write, int scale, 
+void relaxMatrixRows(double ***read, double*** write, int cols, 
 	                 int rowFrom,    int rowTo){
 
 	//---------------------------------------------------------------
@@ -86,7 +179,7 @@ void relaxMatrixRows(double ***read, double*** write, int scale,
     //---------------------------------------------------------------
 
 	for (int i=rowFrom; i<=rowTo; i++){
-		for (int j=1; j<(scale-1); j++){
+		for (int j=1; j<(cols-1); j++){
 
 			double above = (*read)[i-1][j];
 			double below = (*read)[i+1][j];
@@ -99,31 +192,63 @@ void relaxMatrixRows(double ***read, double*** write, int scale,
 }
 
 
-void relaxMatrix(double*** read, double*** write, int scale){
+void relaxMatrix(double*** read, double*** write, int rows, int cols){
 	//---------------------------------------------------------------
     // Relaxes entire matrix by specifying all relaxable rows
     // in function.
     //---------------------------------------------------------------
-	relaxMatrixRows(read, write, scale, 1, scale-2);
+	relaxMatrixRows(read, write, cols, 1, rows-2);
 }
 
 
-void fillMatrix(double ***m, int scale, double min, double max){
+uint64_t mixBits(uint64_t z){
 	//---------------------------------------------------------------
-    // Fills a matrix with random doubles
+    // The splitmix64 finaliser, every input bit reaches every output
+    // bit.
     //---------------------------------------------------------------
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
 
-	srand(time(NULL));
 
-	for (int i=0; i<scale; i++){
-		for (int j=0; j<scale; j++){
-			(*m)[i][j] = ((double) rand() * (max - min)) /
-						 ((double) RAND_MAX + min);
+double randomCell(unsigned int seed, uint64_t index){
+	//---------------------------------------------------------------
+    // A random double in [0, 1) that depends only on the seed and the
+    // cell's index, the index'th output of a splitmix64 generator
+    // started from the mixed seed. Any cell can be made alone, so
+    // threads filling different rows get the same matrix as one.
+    //---------------------------------------------------------------
+	uint64_t z = mixBits(seed) + (index + 1) * 0x9E3779B97F4A7C15ULL;
+	return (double)(mixBits(z) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+void fillMatrixRows(double ***m, int cols, double min, double max,
+                    unsigned int seed, int rowFrom, int rowTo){
+	//---------------------------------------------------------------
+    // Fills the given rows with random doubles between min and max,
+    // each cell's the same for the same seed however rows are shared
+    //---------------------------------------------------------------
+	for (int i=rowFrom; i<=rowTo; i++){
+		uint64_t first = (uint64_t)i*cols;
+		for (int j=0; j<cols; j++){
+			(*m)[i][j] = min + randomCell(seed, first + j) * (max - min);
 		}
 	}
 }
 
 
+void fillMatrix(double ***m, int rows, int cols, double min, double max,
+                unsigned int seed){
+	//---------------------------------------------------------------
+    // Fills a matrix with random doubles, the same ones for the same
+    // seed
+    //---------------------------------------------------------------
+	fillMatrixRows(m, cols, min, max, seed, 0, rows-1);
+}
+
+
 int sameNumberToPrecision(double a, double b, double precision){
 	//---------------------------------------------------------------
     // Checks that two doubles are within a certain precision of
@@ -137,7 +262,100 @@ int sameNumberToPrecision(double a, double b, double precision){
 }
 
 
-int sameMatrixRowsToPrecision(double*** a,      double*** b, int scale,
+int sameFloatToPrecision(float a, float b, double precision){
+	//---------------------------------------------------------------
+    // As sameNumberToPrecision, with a margin of error to suit floats
+    //---------------------------------------------------------------
+	 if (fabsf(a - b) <= precision + 0.000001){
+	 	return 1;
+	 }
+	return 0;
+}
+
+
+float **createMatrixFloat(int rows, int cols){
+	//---------------------------------------------------------------
+    // Creates 2D array of floats, laid out as createMatrix
+    //---------------------------------------------------------------
+	float **matrix = malloc(rows*sizeof(float*));
+	if (matrix == NULL){
+		printf("matrix is null so exiting");
+		exit(0);
+	}
+
+	float *buf = malloc((size_t)rows*cols*sizeof(float));
+	if (buf == NULL){
+		printf("Matrix buffer is null so exiting");
+		exit(0);
+	}
+
+	for (int i=0; i<rows; i++){
+		matrix[i] = buf + ((size_t)cols*i);
+	}
+
+	return matrix;
+}
+
+
+void freeMatrixFloat(float*** matrix){
+	free((*matrix)[0]);
+	free(*matrix);
+	*matrix = NULL;
+}
+
+
+double convertMatrixToFloat(double*** from, float*** to, int rows, int cols){
+	//---------------------------------------------------------------
+    // Rounds a matrix to floats, returning its largest magnitude
+    //---------------------------------------------------------------
+	double max = 0.0;
+	for (int i=0; i<rows; i++){
+		for (int j=0; j<cols; j++){
+			(*to)[i][j] = (float)(*from)[i][j];
+			if (fabs((*from)[i][j]) > max){
+				max = fabs((*from)[i][j]);
+			}
+		}
+	}
+	return max;
+}
+
+
+void convertMatrixToDouble(float*** from, double*** to, int rows, int cols){
+	for (int i=0; i<rows; i++){
+		for (int j=0; j<cols; j++){
+			(*to)[i][j] = (*from)[i][j];
+		}
+	}
+}
+
+
+int sameRowToPrecision(const double *a, const double *b, int cols,
+                       double precision){
+	//---------------------------------------------------------------
+    // Checks whether the interior cells of two rows are the same to
+    // a given precision
+    //---------------------------------------------------------------
+	for (int j=1; j<(cols-1); j++){
+		if (!sameNumberToPrecision(a[j], b[j], precision)){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+double maxRowDifference(const double *a, const double *b, int cols){
+	double max = 0.0;
+	for (int j=1; j<(cols-1); j++){
+		double diff = fabs(a[j] - b[j]);
+		if (diff > max){
+			max = diff;
+		}
+	}
+	return max;
+}
+
+int sameMatrixRowsToPrecision(double*** a,      double*** b, int cols,
 	                          double precision, int rowFrom, int rowTo){
 	
 	//---------------------------------------------------------------
@@ -146,9 +364,242 @@ int sameMatrixRowsToPrecision(double*** a,      double*** b, int scale,
     //---------------------------------------------------------------
 
 	for (int i=rowFrom; i<=rowTo; i++){
-		for (int j=1; j<(scale-1); j++){
+		if (!sameRowToPrecision((*a)[i], (*b)[i], cols, precision)){
+			return 0;
+		}
+	}
+	return 1;
+}
 
-			if (!sameNumberToPrecision((*a)[i][j], (*b)[i][j], precision)){
+double maxMatrixRowsDifference(double*** a, double*** b, int cols,
+	                           int rowFrom, int rowTo){
+
+	//---------------------------------------------------------------
+    // Finds the largest difference between two matrices in the
+    // given rows, without stopping early like the checks above
+    //---------------------------------------------------------------
+	double max = 0.0;
+	for (int i=rowFrom; i<=rowTo; i++){
+		double diff = maxRowDifference((*a)[i], (*b)[i], cols);
+		if (diff > max){
+			max = diff;
+		}
+	}
+	return max;
+}
+
+int sameMatrixToPrecision(double*** a, double*** b, int rows, int cols,
+                          double precision){
+	//---------------------------------------------------------------
+    // Checks whether two matrices are the same to a given precision
+    //---------------------------------------------------------------
+	return sameMatrixRowsToPrecision(a, b, cols, precision, 1, rows-2);
+}
+
+int sameMatrix(double ***a, double ***b, int rows, int cols){
+	//---------------------------------------------------------------
+    // Checks whether two matrices are the same
+    //---------------------------------------------------------------
+	return sameMatrixToPrecision(a, b, rows, cols, 0.0);
+}
+
+
+struct grid {
+	//---------------------------------------------------------------
+    // A matrix in one flat buffer aligned to GRID_ALIGN, each row
+    // padded out to stride cells so every row starts aligned too.
+    // Cell i,j is data[i*stride + j], with no row table to load on
+    // the way. capacity is the cells the buffer holds, which may be
+    // more than the grid uses after gridReuse shrinks it.
+    //---------------------------------------------------------------
+	double *data;
+	int rows;
+	int cols;
+	int stride;
+	size_t capacity;
+};
+
+
+struct grid gridEmpty(){
+	struct grid grid = {NULL, 0, 0, 0, 0};
+	return grid;
+}
+
+
+int gridStride(int cols){
+	int perBlock = GRID_ALIGN / sizeof(double);
+	return (cols + perBlock-1) / perBlock * perBlock;
+}
+
+
+void gridReuse(struct grid *grid, int rows, int cols){
+	//---------------------------------------------------------------
+    // Shapes a grid as rows x cols, keeping its buffer when it is
+    // big enough, so a grid used for many solves only allocates for
+    // the largest. The cells are left as they were.
+    //---------------------------------------------------------------
+	int stride = gridStride(cols);
+	size_t cells = (size_t)rows*stride;
+	if (cells > grid->capacity){
+		free(grid->data);
+		if (posix_memalign((void **)&grid->data, GRID_ALIGN,
+		                   cells*sizeof(double)) != 0){
+			printf("Grid buffer is null so exiting");
+			exit(0);
+		}
+		grid->capacity = cells;
+	}
+	grid->rows = rows;
+	grid->cols = cols;
+	grid->stride = stride;
+}
+
+
+void gridFree(struct grid *grid){
+	free(grid->data);
+	*grid = gridEmpty();
+}
+
+
+double *gridRow(const struct grid *grid, int i){
+	return grid->data + (size_t)i*grid->stride;
+}
+
+
+void gridLoad(struct grid *grid, double ***matrix, int rows, int cols){
+	//---------------------------------------------------------------
+    // Shapes a grid to a matrix and copies the matrix into it
+    //---------------------------------------------------------------
+	gridReuse(grid, rows, cols);
+	for (int i=0; i<rows; i++){
+		memcpy(gridRow(grid, i), (*matrix)[i], cols*sizeof(double));
+	}
+}
+
+
+void gridStore(const struct grid *grid, double ***matrix){
+	//---------------------------------------------------------------
+    // Copies a grid back out into a matrix of the same size
+    //---------------------------------------------------------------
+	for (int i=0; i<grid->rows; i++){
+		memcpy((*matrix)[i], gridRow(grid, i), grid->cols*sizeof(double));
+	}
+}
+
+
+void copyGrid(const struct grid *from, struct grid *to){
+	gridReuse(to, from->rows, from->cols);
+	memcpy(to->data, from->data,
+	       (size_t)from->rows*from->stride*sizeof(double));
+}
+
+
+void printGrid(const struct grid *grid){
+	for (int i=0; i<grid->rows; i++){
+		const double *row = gridRow(grid, i);
+		for (int j=0; j<grid->cols; j++){
+			printf("%.2f ", row[j]);
+		}
+		printf("\n");
+	}
+	printf("\n");
+}
+
+
+struct volume {
+	//---------------------------------------------------------------
+    // A 3D grid of planes x rows x cols in one flat buffer aligned to
+    // GRID_ALIGN. Rows are padded to stride cells as in a grid, and
+    // each plane is rows*stride cells, so cell k,i,j is
+    // data[k*planeStride + i*stride + j]. The outermost planes, rows
+    // and columns are the fixed boundary.
+    //---------------------------------------------------------------
+	double *data;
+	int planes;
+	int rows;
+	int cols;
+	int stride;
+	size_t planeStride;
+};
+
+
+struct volume volumeEmpty(){
+	struct volume volume = {NULL, 0, 0, 0, 0, 0};
+	return volume;
+}
+
+
+struct volume volumeAlloc(int planes, int rows, int cols){
+	//---------------------------------------------------------------
+    // Creates a volume of planes x rows x cols, free it with
+    // volumeFree. The cells are left unset.
+    //---------------------------------------------------------------
+	struct volume volume;
+	volume.planes = planes;
+	volume.rows = rows;
+	volume.cols = cols;
+	volume.stride = gridStride(cols);
+	volume.planeStride = (size_t)rows*volume.stride;
+	if (posix_memalign((void **)&volume.data, GRID_ALIGN,
+	                   planes*volume.planeStride*sizeof(double)) != 0){
+		printf("Volume buffer is null so exiting");
+		exit(0);
+	}
+	return volume;
+}
+
+
+void volumeFree(struct volume *volume){
+	free(volume->data);
+	*volume = volumeEmpty();
+}
+
+
+double *volumeRow(const struct volume *volume, int k, int i){
+	return volume->data + k*volume->planeStride + (size_t)i*volume->stride;
+}
+
+
+void fillVolumePlanes(struct volume *volume, double min, double max,
+                      unsigned int seed, int planeFrom, int planeTo){
+	//---------------------------------------------------------------
+    // Fills the given planes with random doubles between min and max,
+    // each cell's numbered as if the volume were unpadded, so it is
+    // the same for the same seed however the planes are shared out.
+    //---------------------------------------------------------------
+	for (int k=planeFrom; k<=planeTo; k++){
+		for (int i=0; i<volume->rows; i++){
+			double *row = volumeRow(volume, k, i);
+			uint64_t first = ((uint64_t)k*volume->rows + i)*volume->cols;
+			for (int j=0; j<volume->cols; j++){
+				row[j] = min + randomCell(seed, first + j) * (max - min);
+			}
+		}
+	}
+}
+
+
+void copyVolumePlanes(const struct volume *from, struct volume *to,
+                      int planeFrom,            int planeTo){
+	if (planeFrom > planeTo){
+		return;
+	}
+	memcpy(volumeRow(to, planeFrom, 0), volumeRow(from, planeFrom, 0),
+	       (planeTo - planeFrom + 1)*from->planeStride*sizeof(double));
+}
+
+
+int sameVolumePlanesToPrecision(const struct volume *a,
+                                const struct volume *b, double precision,
+                                int planeFrom,          int planeTo){
+	//---------------------------------------------------------------
+    // Checks whether the interior cells of the given planes of two
+    // volumes are the same to a given precision
+    //---------------------------------------------------------------
+	for (int k=planeFrom; k<=planeTo; k++){
+		for (int i=1; i<(a->rows-1); i++){
+			if (!sameRowToPrecision(volumeRow(a, k, i), volumeRow(b, k, i),
+			                        a->cols, precision)){
 				return 0;
 			}
 		}
@@ -156,16 +607,406 @@ int sameMatrixRowsToPrecision(double*** a,      double*** b, int scale,
 	return 1;
 }
 
-int sameMatrixToPrecision(double*** a, double*** b, int scale, double precision){
+
+double maxVolumePlanesDifference(const struct volume *a,
+                                 const struct volume *b,
+                                 int planeFrom,       int planeTo){
+	double max = 0.0;
+	for (int k=planeFrom; k<=planeTo; k++){
+		for (int i=1; i<(a->rows-1); i++){
+			double diff = maxRowDifference(volumeRow(a, k, i),
+			                               volumeRow(b, k, i), a->cols);
+			if (diff > max){
+				max = diff;
+			}
+		}
+	}
+	return max;
+}
+
+
+#define PROBLEM_LAPLACE 0
+#define PROBLEM_POISSON 1
+#define PROBLEM_VARIABLE 2
+
+struct relaxProblem {
 	//---------------------------------------------------------------
-    // Checks whether two matrices are the same to a given precision
+    // The equation a matrix is relaxed towards, div(k grad u) + f = 0
+    // on a grid of unit spacing, f being scaled by the spacing
+    // squared. With k constant it is Laplace without a source, and
+    // Poisson with one, where each cell becomes
+    //
+    //     (above + below + left + right + source) / 4
+    //
+    // source holding f/k. Otherwise each neighbour is weighed by the
+    // coefficient of the edge to it,
+    //
+    //     (north*above + south*below + west*left + east*right + f) * inverse
+    //
+    // where north[i][j] is the edge between cells i-1,j and i,j, so a
+    // cell's south edge is north[i+1][j], west[i][j] the edge between
+    // i,j-1 and i,j, and inverse one over the sum of the four.
     //---------------------------------------------------------------
-	return sameMatrixRowsToPrecision(a, b, scale, precision, 1, scale-2);
+	int kind;
+	int rows;
+	int cols;
+	double **source;
+	double **north;
+	double **west;
+	double **inverse;
+};
+
+
+struct relaxProblem laplaceProblem(int rows, int cols){
+	struct relaxProblem problem = {PROBLEM_LAPLACE, rows, cols,
+	                               NULL, NULL, NULL, NULL};
+	return problem;
 }
 
-int sameMatrix(double ***a, double ***b, int scale){
+
+struct relaxProblem poissonProblem(double ***source, int rows, int cols,
+                                   double coefficient){
 	//---------------------------------------------------------------
-    // Checks whether two matrices are the same
+    // A problem of constant coefficient, taking a copy of the source
+    // divided by it.
+    //---------------------------------------------------------------
+	struct relaxProblem problem = laplaceProblem(rows, cols);
+	problem.kind = PROBLEM_POISSON;
+	problem.source = createMatrix(rows, cols);
+	for (int i=0; i<rows; i++){
+		for (int j=0; j<cols; j++){
+			problem.source[i][j] = (*source)[i][j] / coefficient;
+		}
+	}
+	return problem;
+}
+
+
+int sameValueThroughout(double ***m, int rowFrom, int rowTo,
+                        int colFrom, int colTo){
+	double first = (*m)[rowFrom][colFrom];
+	for (int i=rowFrom; i<=rowTo; i++){
+		for (int j=colFrom; j<=colTo; j++){
+			if ((*m)[i][j] != first){
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+
+int hasNonZero(double ***m, int rows, int cols){
+	for (int i=1; i<(rows-1); i++){
+		for (int j=1; j<(cols-1); j++){
+			if ((*m)[i][j] != 0.0){
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+
+struct relaxProblem variableProblemFromEdges(double ***north, double ***west,
+                                             double ***source,
+                                             int rows, int cols){
+	//---------------------------------------------------------------
+    // A problem with a coefficient for every edge, copied from north
+    // and west, laid out as in relaxProblem, and source, which may be
+    // NULL for none. Every edge a cell of the interior uses must be
+    // above zero. When they are all the same the constant coefficient
+    // problem is returned instead, as it is cheaper to sweep.
     //---------------------------------------------------------------
-	return sameMatrixToPrecision(a, b, scale, 0.0);
-}
\ No newline at end of file
+	for (int i=1; i<rows; i++){
+		for (int j=1; j<(cols-1); j++){
+			if (!((*north)[i][j] > 0.0) ||
+			    (i < rows-1 && !((*west)[i][j] > 0.0 &&
+			                     (*west)[i][j+1] > 0.0))){
+				printf("Coefficients must all be above 0.\n");
+				exit(0);
+			}
+		}
+	}
+
+	double coefficient = (*north)[1][1];
+	if (sameValueThroughout(north, 1, rows-1, 1, cols-2) &&
+	    sameValueThroughout(west, 1, rows-2, 1, cols-1) &&
+	    (*west)[1][1] == coefficient){
+		if (source == NULL || !hasNonZero(source, rows, cols)){
+			return laplaceProblem(rows, cols);
+		}
+		return poissonProblem(source, rows, cols, coefficient);
+	}
+
+	struct relaxProblem problem = laplaceProblem(rows, cols);
+	problem.kind = PROBLEM_VARIABLE;
+	problem.north = createMatrix(rows, cols);
+	problem.west = createMatrix(rows, cols);
+	problem.source = createMatrix(rows, cols);
+	problem.inverse = createMatrix(rows, cols);
+	copyMatrix(north, &problem.north, rows, cols);
+	copyMatrix(west, &problem.west, rows, cols);
+	for (int i=0; i<rows; i++){
+		memset(problem.inverse[i], 0, cols*sizeof(double));
+		if (source == NULL){
+			memset(problem.source[i], 0, cols*sizeof(double));
+		}
+		else{
+			memcpy(problem.source[i], (*source)[i], cols*sizeof(double));
+		}
+	}
+	for (int i=1; i<(rows-1); i++){
+		for (int j=1; j<(cols-1); j++){
+			problem.inverse[i][j] = 1.0 / (problem.north[i][j] +
+			                               problem.north[i+1][j] +
+			                               problem.west[i][j] +
+			                               problem.west[i][j+1]);
+		}
+	}
+	return problem;
+}
+
+
+double harmonicMean(double a, double b){
+	return 2.0*a*b / (a + b);
+}
+
+
+struct relaxProblem variableProblemFromCells(double ***coefficients,
+                                             double ***source,
+                                             int rows, int cols){
+	//---------------------------------------------------------------
+    // A problem with a coefficient for every cell, each edge taking
+    // the harmonic mean of the cells either side, which keeps the
+    // flux through an edge continuous where the coefficient jumps.
+    //---------------------------------------------------------------
+	for (int i=0; i<rows; i++){
+		for (int j=0; j<cols; j++){
+			if (!((*coefficients)[i][j] > 0.0)){
+				printf("Coefficients must all be above 0.\n");
+				exit(0);
+			}
+		}
+	}
+
+	double **north = createMatrix(rows, cols);
+	double **west = createMatrix(rows, cols);
+	for (int i=0; i<rows; i++){
+		for (int j=0; j<cols; j++){
+			north[i][j] = (i == 0) ? 0.0 :
+			              harmonicMean((*coefficients)[i-1][j],
+			                           (*coefficients)[i][j]);
+			west[i][j] = (j == 0) ? 0.0 :
+			             harmonicMean((*coefficients)[i][j-1],
+			                          (*coefficients)[i][j]);
+		}
+	}
+	struct relaxProblem problem = variableProblemFromEdges(&north, &west,
+	                                                       source, rows, cols);
+	freeMatrix(&north);
+	freeMatrix(&west);
+	return problem;
+}
+
+
+void freeProblem(struct relaxProblem *problem){
+	double **fields[4] = {problem->source, problem->north, problem->west,
+	                      problem->inverse};
+	for (int f=0; f<4; f++){
+		if (fields[f] != NULL){
+			freeMatrix(&fields[f]);
+		}
+	}
+	*problem = laplaceProblem(problem->rows, problem->cols);
+}
+
+
+struct cellMask {
+	//---------------------------------------------------------------
+    // The cells of a matrix that are relaxed, as runs of active
+    // cells along each row. The runs of row i are from[k]..to[k] for
+    // k from rowStart[i] up to rowStart[i+1], and activeBefore[i]
+    // counts the active cells in the rows above i, so any band of
+    // rows knows its share of the work without walking it.
+    //---------------------------------------------------------------
+	int rows;
+	int cols;
+	int *rowStart;
+	int *from;
+	int *to;
+	long *activeBefore;
+	long active;
+};
+
+
+struct cellMask createCellMask(double ***fixed, int rows, int cols){
+	//---------------------------------------------------------------
+    // A mask from a matrix whose cells are not 0 where the cell is
+    // held at its value like the boundary, eg holes and obstacles.
+    // The outer ring is always fixed.
+    //---------------------------------------------------------------
+	struct cellMask mask;
+	mask.rows = rows;
+	mask.cols = cols;
+	mask.rowStart = malloc((rows+1)*sizeof(int));
+	mask.activeBefore = malloc((rows+1)*sizeof(long));
+
+	int runs = 0;
+	for (int i=1; i<(rows-1); i++){
+		for (int j=1; j<(cols-1); j++){
+			if ((*fixed)[i][j] == 0.0 &&
+			    (j == 1 || (*fixed)[i][j-1] != 0.0)){
+				runs++;
+			}
+		}
+	}
+	mask.from = malloc((runs > 0 ? runs : 1)*sizeof(int));
+	mask.to = malloc((runs > 0 ? runs : 1)*sizeof(int));
+
+	int run = 0;
+	mask.active = 0;
+	for (int i=0; i<rows; i++){
+		mask.rowStart[i] = run;
+		mask.activeBefore[i] = mask.active;
+		if (i == 0 || i == rows-1){
+			continue;
+		}
+		int j = 1;
+		while (j < cols-1){
+			if ((*fixed)[i][j] != 0.0){
+				j++;
+				continue;
+			}
+			mask.from[run] = j;
+			while (j < cols-1 && (*fixed)[i][j] == 0.0){
+				j++;
+			}
+			mask.to[run] = j-1;
+			mask.active += j - mask.from[run];
+			run++;
+		}
+	}
+	mask.rowStart[rows] = run;
+	mask.activeBefore[rows] = mask.active;
+	return mask;
+}
+
+
+void freeCellMask(struct cellMask *mask){
+	free(mask->rowStart);
+	free(mask->from);
+	free(mask->to);
+	free(mask->activeBefore);
+	mask->rowStart = NULL;
+	mask->from = NULL;
+	mask->to = NULL;
+	mask->activeBefore = NULL;
+}
+
+
+struct dirichletBoundary {
+	//---------------------------------------------------------------
+    // Fixed values for the edges of a matrix. top and bottom hold a
+    // value for every column, corners included, left and right hold
+    // a value for every row, of which the first and last are unused.
+    //---------------------------------------------------------------
+	double *top;
+	double *bottom;
+	double *left;
+	double *right;
+};
+
+
+struct dirichletBoundary createUniformBoundary(int rows,   int cols,
+                                               double top, double bottom,
+                                               double left, double right){
+	//---------------------------------------------------------------
+    // Creates a boundary with one value along each edge
+    //---------------------------------------------------------------
+	struct dirichletBoundary boundary;
+	boundary.top = malloc(cols*sizeof(double));
+	boundary.bottom = malloc(cols*sizeof(double));
+	boundary.left = malloc(rows*sizeof(double));
+	boundary.right = malloc(rows*sizeof(double));
+
+	for (int j=0; j<cols; j++){
+		boundary.top[j] = top;
+		boundary.bottom[j] = bottom;
+	}
+	for (int i=0; i<rows; i++){
+		boundary.left[i] = left;
+		boundary.right[i] = right;
+	}
+	return boundary;
+}
+
+
+void freeBoundary(struct dirichletBoundary *boundary){
+	free(boundary->top);
+	free(boundary->bottom);
+	free(boundary->left);
+	free(boundary->right);
+}
+
+
+void applyBoundary(double ***m, int rows, int cols,
+                   struct dirichletBoundary *boundary){
+	//---------------------------------------------------------------
+    // Writes the boundary values into the edges of a matrix, the
+    // interior is left as it is to start relaxing from.
+    //---------------------------------------------------------------
+	for (int j=0; j<cols; j++){
+		(*m)[0][j] = boundary->top[j];
+		(*m)[rows-1][j] = boundary->bottom[j];
+	}
+	for (int i=1; i<(rows-1); i++){
+		(*m)[i][0] = boundary->left[i];
+		(*m)[i][cols-1] = boundary->right[i];
+	}
+}
+
+struct boundaryChange {
+	//---------------------------------------------------------------
+    // One edge cell of a matrix and the value it is to take
+    //---------------------------------------------------------------
+	int row;
+	int col;
+	double value;
+};
+
+
+struct boundaryChange *boundaryChangesFrom(double ***m, int rows, int cols,
+                                           struct dirichletBoundary *boundary,
+                                           int *changeCount){
+	//---------------------------------------------------------------
+    // Lists the edge cells of a matrix that differ from a boundary,
+    // for re-solving a previous answer after the boundary moves.
+    //---------------------------------------------------------------
+	struct boundaryChange *changes = malloc(2*(rows+cols)*sizeof(struct boundaryChange));
+	if (changes == NULL){
+		printf("Boundary changes are null so exiting");
+		exit(0);
+	}
+
+	int count = 0;
+	for (int j=0; j<cols; j++){
+		if ((*m)[0][j] != boundary->top[j]){
+			changes[count++] = (struct boundaryChange){0, j, boundary->top[j]};
+		}
+		if ((*m)[rows-1][j] != boundary->bottom[j]){
+			changes[count++] = (struct boundaryChange){rows-1, j, boundary->bottom[j]};
+		}
+	}
+	for (int i=1; i<(rows-1); i++){
+		if ((*m)[i][0] != boundary->left[i]){
+			changes[count++] = (struct boundaryChange){i, 0, boundary->left[i]};
+		}
+		if ((*m)[i][cols-1] != boundary->right[i]){
+			changes[count++] = (struct boundaryChange){i, cols-1, boundary->right[i]};
+		}
+	}
+
+	*changeCount = count;
+	return changes;
+}
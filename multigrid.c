@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+//---------------------------------------------------------------
+// Grid transfer and smoothing for the multigrid solver. Every
+// level solves 4u - (above+below+left+right) = b, where b is zero
+// on the finest level. Each side n of a level becomes (n-1)/2 + 1
+// on the next, and coarse cell [I][J] sits on fine cell [2I][2J].
+// Coarse levels solve for the correction to the level above, so
+// their boundary is always zero.
+//---------------------------------------------------------------
+#define CYCLE_V 0
+#define CYCLE_F 1
+
+#define MULTIGRID_COARSEST 5
+
+
+struct multigridLevel {
+    //---------------------------------------------------------------
+    // The solution (or correction), right hand side and residual of
+    // one level. The finest level's u is the matrix being solved and
+    // its b is NULL, meaning zero.
+    //---------------------------------------------------------------
+    int rows;
+    int cols;
+    double **u;
+    double **b;
+    double **r;
+};
+
+
+
+struct multigridLevel *createMultigridLevels(int rows, int cols,
+                                             int *levelCount){
+
+	//---------------------------------------------------------------
+    // Halves the grid until its shorter side is no bigger than
+    // MULTIGRID_COARSEST, so a long thin grid stops coarsening once
+    // the short side runs out.
+    //---------------------------------------------------------------
+	int count = 1;
+	for (int n = rows < cols ? rows : cols; n > MULTIGRID_COARSEST;
+	     n = (n-1)/2 + 1){
+		count++;
+	}
+
+	struct multigridLevel *levels = malloc(count*sizeof(struct multigridLevel));
+	if (levels == NULL){
+		printf("Multigrid levels are null so exiting");
+		exit(0);
+	}
+
+	for (int l=0; l<count; l++){
+		levels[l].rows = rows;
+		levels[l].cols = cols;
+		levels[l].u = (l == 0) ? NULL : createMatrix(rows, cols);
+		levels[l].b = (l == 0) ? NULL : createMatrix(rows, cols);
+		levels[l].r = createMatrix(rows, cols);
+		rows = (rows-1)/2 + 1;
+		cols = (cols-1)/2 + 1;
+	}
+
+	*levelCount = count;
+	return levels;
+}
+
+
+void freeMultigridLevels(struct multigridLevel *levels, int levelCount){
+	for (int l=0; l<levelCount; l++){
+		if (l != 0){
+			freeMatrix(&levels[l].u);
+			freeMatrix(&levels[l].b);
+		}
+		freeMatrix(&levels[l].r);
+	}
+	free(levels);
+}
+
+
+void splitRows(int first, int last, int part, int parts,
+               int *rowFrom, int *rowTo){
+
+	//---------------------------------------------------------------
+    // Splits rows first to last into near equal contiguous parts.
+    // Parts can be empty (rowTo < rowFrom) when there are fewer rows
+    // than parts, as happens on the coarse levels.
+    //---------------------------------------------------------------
+	int rows = last - first + 1;
+	*rowFrom = first + (int)(((long)rows * part) / parts);
+	*rowTo = first + (int)(((long)rows * (part+1)) / parts) - 1;
+}
+
+
+double smoothRowsRedBlack(double **u, double **b, int cols,
+                          int rowFrom, int rowTo, int colour){
+
+	//---------------------------------------------------------------
+    // One colour of a red black Gauss Seidel sweep of 4u - sum = b,
+    // returns the largest change.
+    //---------------------------------------------------------------
+	if (b == NULL){
+		return relaxRowsRedBlack(u, rowFrom, rowTo, 1, cols-2, colour, 1.0);
+	}
+
+	double max = 0.0;
+	for (int i=rowFrom; i<=rowTo; i++){
+		int firstCol = ((i + colour) % 2 == 0) ? 2 : 1;
+
+		for (int j=firstCol; j<(cols-1); j+=2){
+			double value = (u[i-1][j] + u[i+1][j] + u[i][j-1] + u[i][j+1] +
+			                b[i][j]) / 4.0;
+
+			double diff = fabs(value - u[i][j]);
+			if (diff > max){
+				max = diff;
+			}
+			u[i][j] = value;
+		}
+	}
+	return max;
+}
+
+
+double residualRows(double **u, double **b, double **r, int cols,
+                    int rowFrom, int rowTo){
+
+	//---------------------------------------------------------------
+    // Works out r = b - (4u - sum) in the given rows and returns the
+    // largest absolute residual.
+    //---------------------------------------------------------------
+	double max = 0.0;
+	for (int i=rowFrom; i<=rowTo; i++){
+		for (int j=1; j<(cols-1); j++){
+			double value = u[i-1][j] + u[i+1][j] + u[i][j-1] + u[i][j+1] -
+			               4.0*u[i][j];
+			if (b != NULL){
+				value += b[i][j];
+			}
+
+			if (fabs(value) > max){
+				max = fabs(value);
+			}
+			r[i][j] = value;
+		}
+	}
+	return max;
+}
+
+
+void restrictRows(double **fine, double **coarseB, int coarseCols,
+                  int rowFrom,   int rowTo){
+
+	//---------------------------------------------------------------
+    // Full weighting restriction of the fine residual onto the given
+    // coarse rows. The stencil is 1/16 [1 2 1; 2 4 2; 1 2 1], and the
+    // result is scaled by 4 as the coarse cells are twice as wide.
+    //---------------------------------------------------------------
+	for (int I=rowFrom; I<=rowTo; I++){
+		int i = 2*I;
+		for (int J=1; J<(coarseCols-1); J++){
+			int j = 2*J;
+
+			double centre = fine[i][j];
+			double edges = fine[i-1][j] + fine[i+1][j] +
+			               fine[i][j-1] + fine[i][j+1];
+			double corners = fine[i-1][j-1] + fine[i-1][j+1] +
+			                 fine[i+1][j-1] + fine[i+1][j+1];
+
+			coarseB[I][J] = (4.0*centre + 2.0*edges + corners) / 4.0;
+		}
+	}
+}
+
+
+void prolongRows(double **coarse, double **fine, int fineCols,
+                 int rowFrom,     int rowTo){
+
+	//---------------------------------------------------------------
+    // Adds the bilinear interpolation of the coarse correction onto
+    // the given interior rows of the fine level.
+    //---------------------------------------------------------------
+	for (int i=rowFrom; i<=rowTo; i++){
+		int I = i/2;
+		int oddRow = i % 2;
+
+		for (int j=1; j<(fineCols-1); j++){
+			int J = j/2;
+			int oddCol = j % 2;
+
+			double value;
+			if (!oddRow && !oddCol){
+				value = coarse[I][J];
+			}
+			else if (oddRow && !oddCol){
+				value = (coarse[I][J] + coarse[I+1][J]) / 2.0;
+			}
+			else if (!oddRow && oddCol){
+				value = (coarse[I][J] + coarse[I][J+1]) / 2.0;
+			}
+			else{
+				value = (coarse[I][J] + coarse[I+1][J] +
+				         coarse[I][J+1] + coarse[I+1][J+1]) / 4.0;
+			}
+			fine[i][j] += value;
+		}
+	}
+}
+
+
+void zeroRows(double **m, int cols, int rowFrom, int rowTo){
+	for (int i=rowFrom; i<=rowTo; i++){
+		memset(m[i], 0, cols*sizeof(double));
+	}
+}
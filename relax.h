@@ -0,0 +1,121 @@
+#ifndef RELAX_H
+#define RELAX_H
+
+//-------------------------------------------------------------------
+// The public interface of the relaxation solver, for programs that
+// link it as a library rather than running it from the command line.
+// Everything here keeps its meaning between releases, new calls are
+// only ever added. Grids are rows*cols doubles, one row after another,
+// the outermost rows and columns being the fixed boundary, and are
+// solved in place. No call prints, failures are returned, except for
+// running out of memory inside the solver, which exits.
+//-------------------------------------------------------------------
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define RELAX_API __attribute__((visibility("default")))
+#else
+#define RELAX_API
+#endif
+
+#define RELAX_API_VERSION 1
+
+//-------------------------------------------------------------------
+// What every call that can fail returns, the solver or client's
+// error message then says why. RELAX_ERROR_SYSTEM is a solve that
+// finished but could not do all it was asked, such as writing a
+// trace or checkpoint or pinning its threads.
+//-------------------------------------------------------------------
+#define RELAX_OK 0
+#define RELAX_ERROR_ARGUMENT -1
+#define RELAX_ERROR_OPTION -2
+#define RELAX_ERROR_CONNECTION -3
+#define RELAX_ERROR_MEMORY -4
+#define RELAX_ERROR_SYSTEM -5
+
+//-------------------------------------------------------------------
+// Why a solve stopped, settling to the precision or running into
+// one of the maxsweeps, maxtime or stagnation limits.
+//-------------------------------------------------------------------
+#define RELAX_STOPPED_SETTLED 0
+#define RELAX_STOPPED_SWEEPS 1
+#define RELAX_STOPPED_TIME 2
+#define RELAX_STOPPED_STAGNATED 3
+
+struct relaxInfo {
+    //---------------------------------------------------------------
+    // What a solve achieved, the sweeps it took (or multigrid
+    // cycles), the largest change on the last checked sweep, why it
+    // stopped and how long it took.
+    //---------------------------------------------------------------
+    int sweeps;
+    int cycles;
+    double residual;
+    int stopReason;
+    double seconds;
+};
+
+//-------------------------------------------------------------------
+// A solver owns a pool of threads and the scratch buffers for the
+// last size it solved, which are kept warm between solves. One
+// solver may only be used by one thread at a time.
+//-------------------------------------------------------------------
+struct relaxSolver;
+
+RELAX_API int relax_api_version(void);
+
+//-------------------------------------------------------------------
+// Returns NULL when threads is below 1.
+//-------------------------------------------------------------------
+RELAX_API struct relaxSolver *relax_solver_create(int threads);
+RELAX_API void relax_solver_destroy(struct relaxSolver *solver);
+
+//-------------------------------------------------------------------
+// Sets an option for every later solve, by the same name and value
+// as the command line's name=value options, eg "method", "sor". The
+// kernel is chosen for the whole process and can not be set here.
+//-------------------------------------------------------------------
+RELAX_API int relax_solver_set(struct relaxSolver *solver,
+                               const char *name, const char *value);
+
+RELAX_API int relax_solver_solve(struct relaxSolver *solver, double *cells,
+                                 int rows, int cols, double precision,
+                                 struct relaxInfo *info);
+
+RELAX_API const char *relax_solver_error(struct relaxSolver *solver);
+
+//-------------------------------------------------------------------
+// Serves solves to clients on a local socket until one of them asks
+// it to stop. Grids are shared memory the client made, so are solved
+// where they lie and never copied over the socket.
+//-------------------------------------------------------------------
+RELAX_API int relax_serve(struct relaxSolver *solver, const char *socketPath);
+
+//-------------------------------------------------------------------
+// The client side of relax_serve. relax_client_grid returns shared
+// memory for a grid of the size given, to fill and solve with
+// relax_client_solve, which holds the answer once it returns. The
+// options are name=value pairs separated by spaces, and apply to
+// that solve alone. The grid is the client's until the next call
+// to relax_client_grid or relax_client_close.
+//-------------------------------------------------------------------
+struct relaxClient;
+
+RELAX_API struct relaxClient *relax_client_connect(const char *socketPath);
+RELAX_API double *relax_client_grid(struct relaxClient *client,
+                                    int rows, int cols);
+RELAX_API int relax_client_solve(struct relaxClient *client,
+                                 double precision, const char *options,
+                                 struct relaxInfo *info);
+RELAX_API int relax_client_stop_server(struct relaxClient *client);
+RELAX_API const char *relax_client_error(struct relaxClient *client);
+RELAX_API void relax_client_close(struct relaxClient *client);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
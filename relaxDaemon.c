@@ -0,0 +1,75 @@
+#include "relaxLibrary.c"
+
+
+//-------------------------------------------------------------------
+// A long running solver that other programs hand grids to over a
+// local socket, keeping its threads and scratch buffers warm between
+// solves instead of starting them for every grid. Built with
+//
+//     gcc relaxDaemon.c -o relaxd -std=gnu99 -lpthread -lrt -lm -Wall -O2
+//
+// and run as
+//
+//     ./relaxd <socket path> <threads> [name=value ...]
+//
+// where the options are the command line's, and are the defaults
+// every request's own options are applied over.
+//-------------------------------------------------------------------
+int main(int argc, char *argv[]){
+
+    printf("\n");
+    if (argc < 3){
+        printf("Not enough arguments, please provide arguments for");
+        printf(" 'Socket' and 'Threads'.\n");
+        exit(0);
+    }
+
+    int threads = atoi(argv[2]);
+    struct relaxSolver *solver = relax_solver_create(threads);
+    if (solver == NULL){
+        printf("You cannot run on less than 1 thread.\n");
+        exit(0);
+    }
+
+    //---------------------------------------------------------------
+    // The kernel is the process's to choose, so is set here for
+    // every solve rather than on the solver.
+    //---------------------------------------------------------------
+    const char *problem;
+    for (int i=3; i<argc; i++){
+        char *value = strchr(argv[i], '=');
+        if (value == NULL){
+            printf("Option '%s' should be given as name=value.\n", argv[i]);
+            exit(0);
+        }
+        *value = '\0';
+        if (strcmp(argv[i], "kernel") == 0){
+            problem = relax_set_option(&solver->options, argv[i], value+1);
+            if (problem != NULL){
+                printf("%s\n", problem);
+                exit(0);
+            }
+            continue;
+        }
+        if (relax_solver_set(solver, argv[i], value+1) != RELAX_OK){
+            printf("%s\n", relax_solver_error(solver));
+            exit(0);
+        }
+    }
+    problem = relax_options_problem(&solver->options);
+    if (problem != NULL){
+        printf("%s\n", problem);
+        exit(0);
+    }
+
+    printf("Serving solves on %s with %d threads\n", argv[1], threads);
+    fflush(stdout);
+    if (relax_serve(solver, argv[1]) != RELAX_OK){
+        printf("%s\n", relax_solver_error(solver));
+        exit(0);
+    }
+    printf("Stopped serving\n");
+
+    relax_solver_destroy(solver);
+    return 0;
+}
@@ -0,0 +1,992 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <immintrin.h>
+
+
+//---------------------------------------------------------------
+// Fused relaxation kernels. Each one relaxes a row into the write
+// matrix and returns the largest change of any cell in the same
+// pass, so checking precision costs no extra trip through memory.
+//
+// Sums are always added as ((above+below)+left)+right, then scaled
+// by a quarter, so every kernel gives bitwise the same answer as
+// relaxMatrixRows.
+//---------------------------------------------------------------
+#define KERNEL_AUTO 0
+#define KERNEL_SCALAR 1
+#define KERNEL_AVX2 2
+#define KERNEL_AVX512 3
+
+
+struct changeNorms {
+	//---------------------------------------------------------------
+    // What a sweep did to a block of cells, the largest change, the
+    // sum of the squared changes and the largest magnitude of any
+    // cell afterwards, for the stopping rules that need more than
+    // the largest change.
+    //---------------------------------------------------------------
+	double max;
+	double sumSquares;
+	double largest;
+};
+
+
+typedef double (*relaxRowFunction)(const double *above, const double *row,
+                                   const double *below, double *write,
+                                   int cols);
+
+typedef float (*relaxRowFloatFunction)(const float *above, const float *row,
+                                       const float *below, float *write,
+                                       int cols);
+
+typedef double (*relaxVolumeRowFunction)(const double *above,
+                                         const double *row,
+                                         const double *below,
+                                         const double *front,
+                                         const double *back, double *write,
+                                         int cols);
+
+typedef double (*relaxRowPoissonFunction)(const double *above,
+                                          const double *row,
+                                          const double *below,
+                                          const double *source,
+                                          double *write, int cols);
+
+typedef double (*relaxRowVariableFunction)(const double *above,
+                                           const double *row,
+                                           const double *below,
+                                           const double *north,
+                                           const double *south,
+                                           const double *west,
+                                           const double *source,
+                                           const double *inverse,
+                                           double *write, int cols);
+
+
+double relaxRowScalar(const double *above, const double *row,
+                      const double *below, double *write, int cols){
+
+	double max = 0.0;
+	for (int j=1; j<(cols-1); j++){
+		double value = (above[j] + below[j] + row[j-1] + row[j+1]) / 4.0;
+
+		double diff = fabs(value - row[j]);
+		if (diff > max){
+			max = diff;
+		}
+		write[j] = value;
+	}
+	return max;
+}
+
+
+__attribute__((target("avx2")))
+double relaxRowAVX2(const double *above, const double *row,
+                    const double *below, double *write, int cols){
+
+	const __m256d quarter = _mm256_set1_pd(0.25);
+	const __m256d signMask = _mm256_set1_pd(-0.0);
+	__m256d maxDiff = _mm256_setzero_pd();
+
+	int j = 1;
+	for (; j+4 <= (cols-1); j+=4){
+		__m256d sum = _mm256_add_pd(_mm256_loadu_pd(above + j),
+		                            _mm256_loadu_pd(below + j));
+		sum = _mm256_add_pd(sum, _mm256_loadu_pd(row + j - 1));
+		sum = _mm256_add_pd(sum, _mm256_loadu_pd(row + j + 1));
+		__m256d value = _mm256_mul_pd(sum, quarter);
+
+		__m256d diff = _mm256_sub_pd(value, _mm256_loadu_pd(row + j));
+		maxDiff = _mm256_max_pd(maxDiff, _mm256_andnot_pd(signMask, diff));
+		_mm256_storeu_pd(write + j, value);
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, maxDiff);
+	double max = lanes[0];
+	for (int k=1; k<4; k++){
+		if (lanes[k] > max){
+			max = lanes[k];
+		}
+	}
+
+	//---------------------------------------------------------------
+	// Finish any columns left over from the vector width
+	//---------------------------------------------------------------
+	for (; j<(cols-1); j++){
+		double value = (above[j] + below[j] + row[j-1] + row[j+1]) / 4.0;
+		double diff = fabs(value - row[j]);
+		if (diff > max){
+			max = diff;
+		}
+		write[j] = value;
+	}
+	return max;
+}
+
+
+__attribute__((target("avx512f")))
+double relaxRowAVX512(const double *above, const double *row,
+                      const double *below, double *write, int cols){
+
+	const __m512d quarter = _mm512_set1_pd(0.25);
+	__m512d maxDiff = _mm512_setzero_pd();
+
+	int j = 1;
+	for (; j+8 <= (cols-1); j+=8){
+		__m512d sum = _mm512_add_pd(_mm512_loadu_pd(above + j),
+		                            _mm512_loadu_pd(below + j));
+		sum = _mm512_add_pd(sum, _mm512_loadu_pd(row + j - 1));
+		sum = _mm512_add_pd(sum, _mm512_loadu_pd(row + j + 1));
+		__m512d value = _mm512_mul_pd(sum, quarter);
+
+		__m512d diff = _mm512_sub_pd(value, _mm512_loadu_pd(row + j));
+		maxDiff = _mm512_max_pd(maxDiff, _mm512_abs_pd(diff));
+		_mm512_storeu_pd(write + j, value);
+	}
+
+	double max = _mm512_reduce_max_pd(maxDiff);
+
+	//---------------------------------------------------------------
+	// Finish any columns left over from the vector width
+	//---------------------------------------------------------------
+	for (; j<(cols-1); j++){
+		double value = (above[j] + below[j] + row[j-1] + row[j+1]) / 4.0;
+		double diff = fabs(value - row[j]);
+		if (diff > max){
+			max = diff;
+		}
+		write[j] = value;
+	}
+	return max;
+}
+
+
+//---------------------------------------------------------------
+// Float versions of the kernels, a vector holds twice as many
+// cells so each sweep moves half the memory.
+//---------------------------------------------------------------
+float relaxRowFloatScalar(const float *above, const float *row,
+                          const float *below, float *write, int cols){
+
+	float max = 0.0f;
+	for (int j=1; j<(cols-1); j++){
+		float value = (above[j] + below[j] + row[j-1] + row[j+1]) * 0.25f;
+
+		float diff = fabsf(value - row[j]);
+		if (diff > max){
+			max = diff;
+		}
+		write[j] = value;
+	}
+	return max;
+}
+
+
+__attribute__((target("avx2")))
+float relaxRowFloatAVX2(const float *above, const float *row,
+                        const float *below, float *write, int cols){
+
+	const __m256 quarter = _mm256_set1_ps(0.25f);
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	__m256 maxDiff = _mm256_setzero_ps();
+
+	int j = 1;
+	for (; j+8 <= (cols-1); j+=8){
+		__m256 sum = _mm256_add_ps(_mm256_loadu_ps(above + j),
+		                           _mm256_loadu_ps(below + j));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(row + j - 1));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(row + j + 1));
+		__m256 value = _mm256_mul_ps(sum, quarter);
+
+		__m256 diff = _mm256_sub_ps(value, _mm256_loadu_ps(row + j));
+		maxDiff = _mm256_max_ps(maxDiff, _mm256_andnot_ps(signMask, diff));
+		_mm256_storeu_ps(write + j, value);
+	}
+
+	float lanes[8];
+	_mm256_storeu_ps(lanes, maxDiff);
+	float max = lanes[0];
+	for (int k=1; k<8; k++){
+		if (lanes[k] > max){
+			max = lanes[k];
+		}
+	}
+
+	for (; j<(cols-1); j++){
+		float value = (above[j] + below[j] + row[j-1] + row[j+1]) * 0.25f;
+		float diff = fabsf(value - row[j]);
+		if (diff > max){
+			max = diff;
+		}
+		write[j] = value;
+	}
+	return max;
+}
+
+
+__attribute__((target("avx512f")))
+float relaxRowFloatAVX512(const float *above, const float *row,
+                          const float *below, float *write, int cols){
+
+	const __m512 quarter = _mm512_set1_ps(0.25f);
+	__m512 maxDiff = _mm512_setzero_ps();
+
+	int j = 1;
+	for (; j+16 <= (cols-1); j+=16){
+		__m512 sum = _mm512_add_ps(_mm512_loadu_ps(above + j),
+		                           _mm512_loadu_ps(below + j));
+		sum = _mm512_add_ps(sum, _mm512_loadu_ps(row + j - 1));
+		sum = _mm512_add_ps(sum, _mm512_loadu_ps(row + j + 1));
+		__m512 value = _mm512_mul_ps(sum, quarter);
+
+		__m512 diff = _mm512_sub_ps(value, _mm512_loadu_ps(row + j));
+		maxDiff = _mm512_max_ps(maxDiff, _mm512_abs_ps(diff));
+		_mm512_storeu_ps(write + j, value);
+	}
+
+	float max = _mm512_reduce_max_ps(maxDiff);
+
+	for (; j<(cols-1); j++){
+		float value = (above[j] + below[j] + row[j-1] + row[j+1]) * 0.25f;
+		float diff = fabsf(value - row[j]);
+		if (diff > max){
+			max = diff;
+		}
+		write[j] = value;
+	}
+	return max;
+}
+
+
+//---------------------------------------------------------------
+// The 7 point kernels of a volume row, front and back being the
+// same row of the planes either side. Sums are added as
+// ((((above+below)+front)+back)+left)+right and divided by six,
+// which unlike a quarter is not exact as a multiply, so the vector
+// kernel divides too and matches the scalar one bitwise.
+//---------------------------------------------------------------
+double relaxVolumeRowScalar(const double *above, const double *row,
+                            const double *below, const double *front,
+                            const double *back,  double *write, int cols){
+
+	double max = 0.0;
+	for (int j=1; j<(cols-1); j++){
+		double value = (above[j] + below[j] + front[j] + back[j] +
+		                row[j-1] + row[j+1]) / 6.0;
+
+		double diff = fabs(value - row[j]);
+		if (diff > max){
+			max = diff;
+		}
+		write[j] = value;
+	}
+	return max;
+}
+
+
+__attribute__((target("avx2")))
+double relaxVolumeRowAVX2(const double *above, const double *row,
+                          const double *below, const double *front,
+                          const double *back,  double *write, int cols){
+
+	const __m256d six = _mm256_set1_pd(6.0);
+	const __m256d signMask = _mm256_set1_pd(-0.0);
+	__m256d maxDiff = _mm256_setzero_pd();
+
+	int j = 1;
+	for (; j+4 <= (cols-1); j+=4){
+		__m256d sum = _mm256_add_pd(_mm256_loadu_pd(above + j),
+		                            _mm256_loadu_pd(below + j));
+		sum = _mm256_add_pd(sum, _mm256_loadu_pd(front + j));
+		sum = _mm256_add_pd(sum, _mm256_loadu_pd(back + j));
+		sum = _mm256_add_pd(sum, _mm256_loadu_pd(row + j - 1));
+		sum = _mm256_add_pd(sum, _mm256_loadu_pd(row + j + 1));
+		__m256d value = _mm256_div_pd(sum, six);
+
+		__m256d diff = _mm256_sub_pd(value, _mm256_loadu_pd(row + j));
+		maxDiff = _mm256_max_pd(maxDiff, _mm256_andnot_pd(signMask, diff));
+		_mm256_storeu_pd(write + j, value);
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, maxDiff);
+	double max = lanes[0];
+	for (int k=1; k<4; k++){
+		if (lanes[k] > max){
+			max = lanes[k];
+		}
+	}
+
+	for (; j<(cols-1); j++){
+		double value = (above[j] + below[j] + front[j] + back[j] +
+		                row[j-1] + row[j+1]) / 6.0;
+		double diff = fabs(value - row[j]);
+		if (diff > max){
+			max = diff;
+		}
+		write[j] = value;
+	}
+	return max;
+}
+
+
+//---------------------------------------------------------------
+// The kernels of a relaxProblem's rows, source, north, south, west
+// and inverse being the same row of its fields, south the north
+// edges of the row below. Poisson rows add the source last and
+// take a quarter, variable ones weigh each neighbour by its edge as
+// (((north*above + south*below) + west*left) + east*right) + source
+// and multiply by the inverse. Neither divides, so the vector
+// kernels match the scalar ones bitwise, and they stream one more
+// input (or five) beside the grid rather than gathering anything.
+//---------------------------------------------------------------
+double relaxRowPoissonScalar(const double *above, const double *row,
+                             const double *below, const double *source,
+                             double *write,       int cols){
+
+	double max = 0.0;
+	for (int j=1; j<(cols-1); j++){
+		double value = (above[j] + below[j] + row[j-1] + row[j+1] +
+		                source[j]) * 0.25;
+
+		double diff = fabs(value - row[j]);
+		if (diff > max){
+			max = diff;
+		}
+		write[j] = value;
+	}
+	return max;
+}
+
+
+__attribute__((target("avx2")))
+double relaxRowPoissonAVX2(const double *above, const double *row,
+                           const double *below, const double *source,
+                           double *write,       int cols){
+
+	const __m256d quarter = _mm256_set1_pd(0.25);
+	const __m256d signMask = _mm256_set1_pd(-0.0);
+	__m256d maxDiff = _mm256_setzero_pd();
+
+	int j = 1;
+	for (; j+4 <= (cols-1); j+=4){
+		__m256d sum = _mm256_add_pd(_mm256_loadu_pd(above + j),
+		                            _mm256_loadu_pd(below + j));
+		sum = _mm256_add_pd(sum, _mm256_loadu_pd(row + j - 1));
+		sum = _mm256_add_pd(sum, _mm256_loadu_pd(row + j + 1));
+		sum = _mm256_add_pd(sum, _mm256_loadu_pd(source + j));
+		__m256d value = _mm256_mul_pd(sum, quarter);
+
+		__m256d diff = _mm256_sub_pd(value, _mm256_loadu_pd(row + j));
+		maxDiff = _mm256_max_pd(maxDiff, _mm256_andnot_pd(signMask, diff));
+		_mm256_storeu_pd(write + j, value);
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, maxDiff);
+	double max = lanes[0];
+	for (int k=1; k<4; k++){
+		if (lanes[k] > max){
+			max = lanes[k];
+		}
+	}
+
+	for (; j<(cols-1); j++){
+		double value = (above[j] + below[j] + row[j-1] + row[j+1] +
+		                source[j]) * 0.25;
+		double diff = fabs(value - row[j]);
+		if (diff > max){
+			max = diff;
+		}
+		write[j] = value;
+	}
+	return max;
+}
+
+
+double relaxRowVariableScalar(const double *above, const double *row,
+                              const double *below, const double *north,
+                              const double *south, const double *west,
+                              const double *source, const double *inverse,
+                              double *write,       int cols){
+
+	double max = 0.0;
+	for (int j=1; j<(cols-1); j++){
+		double value = (north[j]*above[j] + south[j]*below[j] +
+		                west[j]*row[j-1] + west[j+1]*row[j+1] +
+		                source[j]) * inverse[j];
+
+		double diff = fabs(value - row[j]);
+		if (diff > max){
+			max = diff;
+		}
+		write[j] = value;
+	}
+	return max;
+}
+
+
+__attribute__((target("avx2")))
+double relaxRowVariableAVX2(const double *above, const double *row,
+                            const double *below, const double *north,
+                            const double *south, const double *west,
+                            const double *source, const double *inverse,
+                            double *write,       int cols){
+
+	const __m256d signMask = _mm256_set1_pd(-0.0);
+	__m256d maxDiff = _mm256_setzero_pd();
+
+	int j = 1;
+	for (; j+4 <= (cols-1); j+=4){
+		__m256d sum = _mm256_add_pd(
+		    _mm256_mul_pd(_mm256_loadu_pd(north + j),
+		                  _mm256_loadu_pd(above + j)),
+		    _mm256_mul_pd(_mm256_loadu_pd(south + j),
+		                  _mm256_loadu_pd(below + j)));
+		sum = _mm256_add_pd(sum,
+		    _mm256_mul_pd(_mm256_loadu_pd(west + j),
+		                  _mm256_loadu_pd(row + j - 1)));
+		sum = _mm256_add_pd(sum,
+		    _mm256_mul_pd(_mm256_loadu_pd(west + j + 1),
+		                  _mm256_loadu_pd(row + j + 1)));
+		sum = _mm256_add_pd(sum, _mm256_loadu_pd(source + j));
+		__m256d value = _mm256_mul_pd(sum, _mm256_loadu_pd(inverse + j));
+
+		__m256d diff = _mm256_sub_pd(value, _mm256_loadu_pd(row + j));
+		maxDiff = _mm256_max_pd(maxDiff, _mm256_andnot_pd(signMask, diff));
+		_mm256_storeu_pd(write + j, value);
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, maxDiff);
+	double max = lanes[0];
+	for (int k=1; k<4; k++){
+		if (lanes[k] > max){
+			max = lanes[k];
+		}
+	}
+
+	for (; j<(cols-1); j++){
+		double value = (north[j]*above[j] + south[j]*below[j] +
+		                west[j]*row[j-1] + west[j+1]*row[j+1] +
+		                source[j]) * inverse[j];
+		double diff = fabs(value - row[j]);
+		if (diff > max){
+			max = diff;
+		}
+		write[j] = value;
+	}
+	return max;
+}
+
+
+relaxRowFunction relaxRow = NULL;
+relaxRowPoissonFunction relaxRowPoisson = NULL;
+relaxRowVariableFunction relaxRowVariable = NULL;
+relaxRowFloatFunction relaxRowFloat = NULL;
+relaxVolumeRowFunction relaxVolumeRow = NULL;
+int relaxKernel = KERNEL_SCALAR;
+
+
+int selectRelaxKernel(int requested){
+	//---------------------------------------------------------------
+    // Picks the widest kernel the CPU supports, or the one asked
+    // for if it is supported. Returns the kernel actually chosen.
+    //---------------------------------------------------------------
+	__builtin_cpu_init();
+	int hasAVX512 = __builtin_cpu_supports("avx512f");
+	int hasAVX2 = __builtin_cpu_supports("avx2");
+
+	if (requested == KERNEL_AUTO){
+		requested = hasAVX512 ? KERNEL_AVX512 :
+		            hasAVX2 ? KERNEL_AVX2 : KERNEL_SCALAR;
+	}
+	if ((requested == KERNEL_AVX512 && !hasAVX512) ||
+	    (requested == KERNEL_AVX2 && !hasAVX2)){
+		printf("Requested kernel is not supported, using scalar.\n");
+		requested = KERNEL_SCALAR;
+	}
+
+	//---------------------------------------------------------------
+    // Volume and problem rows are limited by their input streams
+    // rather than arithmetic, so AVX-512 uses the AVX2 kernels.
+    //---------------------------------------------------------------
+	if (requested == KERNEL_AVX512){
+		relaxRow = &relaxRowAVX512;
+		relaxRowFloat = &relaxRowFloatAVX512;
+		relaxVolumeRow = &relaxVolumeRowAVX2;
+		relaxRowPoisson = &relaxRowPoissonAVX2;
+		relaxRowVariable = &relaxRowVariableAVX2;
+	}
+	else if (requested == KERNEL_AVX2){
+		relaxRow = &relaxRowAVX2;
+		relaxRowFloat = &relaxRowFloatAVX2;
+		relaxVolumeRow = &relaxVolumeRowAVX2;
+		relaxRowPoisson = &relaxRowPoissonAVX2;
+		relaxRowVariable = &relaxRowVariableAVX2;
+	}
+	else{
+		relaxRow = &relaxRowScalar;
+		relaxRowFloat = &relaxRowFloatScalar;
+		relaxVolumeRow = &relaxVolumeRowScalar;
+		relaxRowPoisson = &relaxRowPoissonScalar;
+		relaxRowVariable = &relaxRowVariableScalar;
+	}
+	relaxKernel = requested;
+	return requested;
+}
+
+
+const char *relaxKernelName(int kernel){
+	if (kernel == KERNEL_AVX512){
+		return "AVX-512";
+	}
+	if (kernel == KERNEL_AVX2){
+		return "AVX2";
+	}
+	return "Scalar";
+}
+
+
+double relaxRowsFused(const double *read, double *write, int cols,
+                      int rowFrom,        int rowTo){
+
+	//---------------------------------------------------------------
+    // Relaxes the given rows of a flat row major matrix into another
+    // and returns the largest change made. Matrices from createMatrix
+    // are a single buffer, so (*matrix)[0] can be passed directly.
+    // A kernel must have been selected before any threads call this.
+    //---------------------------------------------------------------
+	double max = 0.0;
+	for (int i=rowFrom; i<=rowTo; i++){
+		const double *row = read + (size_t)i*cols;
+
+		double diff = relaxRow(row - cols, row, row + cols,
+		                       write + (size_t)i*cols, cols);
+		if (diff > max){
+			max = diff;
+		}
+	}
+	return max;
+}
+
+
+double relaxMatrixRowsFused(double ***read, double ***write, int cols,
+                            int rowFrom,    int rowTo){
+	return relaxRowsFused((*read)[0], (*write)[0], cols, rowFrom, rowTo);
+}
+
+
+double relaxGridRowsFused(const struct grid *read, struct grid *write,
+                          int rowFrom,             int rowTo){
+
+	//---------------------------------------------------------------
+    // relaxRowsFused on grids, stepping a padded stride between rows
+    // so each row handed to the kernel starts aligned.
+    //---------------------------------------------------------------
+	double max = 0.0;
+	for (int i=rowFrom; i<=rowTo; i++){
+		double diff = relaxRow(gridRow(read, i-1), gridRow(read, i),
+		                       gridRow(read, i+1), gridRow(write, i),
+		                       read->cols);
+		if (diff > max){
+			max = diff;
+		}
+	}
+	return max;
+}
+
+
+double relaxColumnsFused(const double *above, const double *row,
+                         const double *below, double *write,
+                         int colFrom,         int colTo){
+	//---------------------------------------------------------------
+    // Runs the row kernel over columns colFrom to colTo only, by
+    // offsetting the row so those columns are its interior.
+    //---------------------------------------------------------------
+	int offset = colFrom - 1;
+	return relaxRow(above + offset, row + offset, below + offset,
+	                write + offset, colTo - colFrom + 3);
+}
+
+
+double relaxMatrixBlockFused(double ***read, double ***write, int cols,
+                             int rowFrom,    int rowTo,
+                             int colFrom,    int colTo){
+	//---------------------------------------------------------------
+    // Relaxes the rectangle rowFrom..rowTo by colFrom..colTo, going
+    // through the whole row kernel when the block is full width.
+    //---------------------------------------------------------------
+	if (colFrom == 1 && colTo == cols-2){
+		return relaxMatrixRowsFused(read, write, cols, rowFrom, rowTo);
+	}
+
+	double max = 0.0;
+	for (int i=rowFrom; i<=rowTo; i++){
+		double diff = relaxColumnsFused((*read)[i-1], (*read)[i], (*read)[i+1],
+		                                (*write)[i], colFrom, colTo);
+		if (diff > max){
+			max = diff;
+		}
+	}
+	return max;
+}
+
+
+double relaxProblemBlock(const struct relaxProblem *problem,
+                         double ***read, double ***write, int cols,
+                         int rowFrom,    int rowTo,
+                         int colFrom,    int colTo){
+	//---------------------------------------------------------------
+    // relaxMatrixBlockFused towards problem, which when NULL or
+    // Laplace is exactly that. Rows are offset as in
+    // relaxColumnsFused, the problem's fields along with them.
+    //---------------------------------------------------------------
+	if (problem == NULL || problem->kind == PROBLEM_LAPLACE){
+		return relaxMatrixBlockFused(read, write, cols, rowFrom, rowTo,
+		                             colFrom, colTo);
+	}
+
+	int offset = colFrom - 1;
+	int width = colTo - colFrom + 3;
+	double max = 0.0;
+	for (int i=rowFrom; i<=rowTo; i++){
+		double diff;
+		if (problem->kind == PROBLEM_POISSON){
+			diff = relaxRowPoisson((*read)[i-1] + offset,
+			                       (*read)[i] + offset,
+			                       (*read)[i+1] + offset,
+			                       problem->source[i] + offset,
+			                       (*write)[i] + offset, width);
+		}
+		else{
+			diff = relaxRowVariable((*read)[i-1] + offset,
+			                        (*read)[i] + offset,
+			                        (*read)[i+1] + offset,
+			                        problem->north[i] + offset,
+			                        problem->north[i+1] + offset,
+			                        problem->west[i] + offset,
+			                        problem->source[i] + offset,
+			                        problem->inverse[i] + offset,
+			                        (*write)[i] + offset, width);
+		}
+		if (diff > max){
+			max = diff;
+		}
+	}
+	return max;
+}
+
+
+double relaxMaskedBlock(const struct cellMask *mask,
+                        const struct relaxProblem *problem,
+                        double ***read, double ***write, int cols,
+                        int rowFrom,    int rowTo,
+                        int colFrom,    int colTo){
+	//---------------------------------------------------------------
+    // relaxProblemBlock over only the active runs of mask inside the
+    // block, each run going through the vector kernels whole, so
+    // fixed cells cost nothing and are never written. A NULL mask
+    // relaxes the whole block.
+    //---------------------------------------------------------------
+	if (mask == NULL){
+		return relaxProblemBlock(problem, read, write, cols, rowFrom, rowTo,
+		                         colFrom, colTo);
+	}
+
+	double max = 0.0;
+	for (int i=rowFrom; i<=rowTo; i++){
+		for (int k=mask->rowStart[i]; k<mask->rowStart[i+1]; k++){
+			int from = mask->from[k] > colFrom ? mask->from[k] : colFrom;
+			int to = mask->to[k] < colTo ? mask->to[k] : colTo;
+			if (from > to){
+				continue;
+			}
+			double diff = relaxProblemBlock(problem, read, write, cols,
+			                                i, i, from, to);
+			if (diff > max){
+				max = diff;
+			}
+		}
+	}
+	return max;
+}
+
+
+float relaxMatrixBlockFusedFloat(float ***read, float ***write,
+                                 int rowFrom,   int rowTo,
+                                 int colFrom,   int colTo){
+	//---------------------------------------------------------------
+    // relaxMatrixBlockFused for float matrices
+    //---------------------------------------------------------------
+	int offset = colFrom - 1;
+	int n = colTo - colFrom + 3;
+
+	float max = 0.0f;
+	for (int i=rowFrom; i<=rowTo; i++){
+		float diff = relaxRowFloat((*read)[i-1] + offset, (*read)[i] + offset,
+		                           (*read)[i+1] + offset, (*write)[i] + offset,
+		                           n);
+		if (diff > max){
+			max = diff;
+		}
+	}
+	return max;
+}
+
+
+double relaxVolumeBlock(const struct volume *read, struct volume *write,
+                        int planeFrom, int planeTo, int rowFrom, int rowTo,
+                        int tileRows,  int tileCols){
+
+	//---------------------------------------------------------------
+    // Relaxes planes planeFrom..planeTo by rows rowFrom..rowTo of a
+    // volume, returning the largest change. The rows and columns are
+    // cut into tiles of tileRows x tileCols, and each tile is swept
+    // through every plane before the next, so the three planes of a
+    // tile each row reads stay in cache while it moves along them,
+    // rather than whole planes having to.
+    //---------------------------------------------------------------
+	int cols = read->cols;
+	double max = 0.0;
+	for (int ti=rowFrom; ti<=rowTo; ti+=tileRows){
+		int tileEnd = (ti + tileRows - 1 < rowTo) ? ti + tileRows - 1 : rowTo;
+		for (int tj=1; tj<=cols-2; tj+=tileCols){
+			int colTo = (tj + tileCols - 1 < cols-2) ? tj + tileCols - 1 : cols-2;
+			int offset = tj - 1;
+			int n = colTo - tj + 3;
+
+			for (int k=planeFrom; k<=planeTo; k++){
+				for (int i=ti; i<=tileEnd; i++){
+					double diff = relaxVolumeRow(volumeRow(read, k, i-1) + offset,
+					                             volumeRow(read, k, i) + offset,
+					                             volumeRow(read, k, i+1) + offset,
+					                             volumeRow(read, k-1, i) + offset,
+					                             volumeRow(read, k+1, i) + offset,
+					                             volumeRow(write, k, i) + offset,
+					                             n);
+					if (diff > max){
+						max = diff;
+					}
+				}
+			}
+		}
+	}
+	return max;
+}
+
+
+void measureChangeRow(const double *now, const double *before, int colFrom,
+                      int colTo,         struct changeNorms *norms){
+	//---------------------------------------------------------------
+    // Adds the squared changes of a row between two Jacobi sweeps
+    // to norms, and maxes in the largest magnitude now in it. The
+    // largest change already comes from the fused kernels.
+    //---------------------------------------------------------------
+	double sumSquares = 0.0;
+	double largest = norms->largest;
+	for (int j=colFrom; j<=colTo; j++){
+		double diff = now[j] - before[j];
+		sumSquares += diff*diff;
+		if (fabs(now[j]) > largest){
+			largest = fabs(now[j]);
+		}
+	}
+	norms->sumSquares += sumSquares;
+	norms->largest = largest;
+}
+
+
+void measureChangeRows(double **now, double **before, int rowFrom, int rowTo,
+                       int colFrom,   int colTo,       struct changeNorms *norms){
+	for (int i=rowFrom; i<=rowTo; i++){
+		measureChangeRow(now[i], before[i], colFrom, colTo, norms);
+	}
+}
+
+
+void measureChangeGridRows(const struct grid *now, const struct grid *before,
+                           int rowFrom,            int rowTo,
+                           struct changeNorms *norms){
+	for (int i=rowFrom; i<=rowTo; i++){
+		measureChangeRow(gridRow(now, i), gridRow(before, i), 1,
+		                 now->cols-2, norms);
+	}
+}
+
+
+void relaxTile(double **source, double **target, int rows, int cols,
+               int rowFrom,     int rowTo,
+               int colFrom,     int colTo,
+               int depth,       double *a,
+               double *b,       double *sweepResiduals){
+
+	//---------------------------------------------------------------
+    // Runs 'depth' Jacobi sweeps of one tile of source without going
+    // back to main memory, and writes the final values of the tile
+    // into target. The tile is copied in with a halo 'depth' cells
+    // deep that shrinks by one cell each sweep, so every value the
+    // tile computes is exactly the value plain Jacobi would give.
+    // The largest change on each sweep is maxed into sweepResiduals.
+    //---------------------------------------------------------------
+	int haloRowFrom = rowFrom - depth < 0 ? 0 : rowFrom - depth;
+	int haloRowTo = rowTo + depth > rows-1 ? rows-1 : rowTo + depth;
+	int haloColFrom = colFrom - depth < 0 ? 0 : colFrom - depth;
+	int haloColTo = colTo + depth > cols-1 ? cols-1 : colTo + depth;
+	int width = haloColTo - haloColFrom + 1;
+
+	//---------------------------------------------------------------
+    // Both buffers start as the source so the fixed boundary cells
+    // are present whichever buffer is read.
+    //---------------------------------------------------------------
+	for (int i=haloRowFrom; i<=haloRowTo; i++){
+		size_t bytes = width*sizeof(double);
+		memcpy(a + (size_t)(i-haloRowFrom)*width,
+		       source[i] + haloColFrom, bytes);
+		memcpy(b + (size_t)(i-haloRowFrom)*width,
+		       source[i] + haloColFrom, bytes);
+	}
+
+	for (int s=1; s<=depth; s++){
+		int halo = depth - s;
+		int fromRow = rowFrom - halo < 1 ? 1 : rowFrom - halo;
+		int toRow = rowTo + halo > rows-2 ? rows-2 : rowTo + halo;
+		int fromCol = colFrom - halo < 1 ? 1 : colFrom - halo;
+		int toCol = colTo + halo > cols-2 ? cols-2 : colTo + halo;
+
+		double max = 0.0;
+		for (int i=fromRow; i<=toRow; i++){
+			size_t base = (size_t)(i-haloRowFrom)*width;
+			const double *row = a + base;
+			double diff = relaxColumnsFused(row - width, row, row + width,
+			                                b + base,
+			                                fromCol - haloColFrom,
+			                                toCol - haloColFrom);
+			if (diff > max){
+				max = diff;
+			}
+		}
+		if (max > sweepResiduals[s-1]){
+			sweepResiduals[s-1] = max;
+		}
+
+		double *temp = a;
+		a = b;
+		b = temp;
+	}
+
+	for (int i=rowFrom; i<=rowTo; i++){
+		memcpy(target[i] + colFrom,
+		       a + (size_t)(i-haloRowFrom)*width + (colFrom-haloColFrom),
+		       (colTo-colFrom+1)*sizeof(double));
+	}
+}
+
+
+double relaxRowRedBlack(const double *above, double *row,
+                        const double *below, int firstCol,
+                        int lastCol,         double omega){
+
+	//---------------------------------------------------------------
+    // Relaxes every other cell of a row in place, from firstCol up to
+    // lastCol, over relaxing by omega. An omega of 1 is plain Gauss
+    // Seidel and skips the extra arithmetic.
+    //---------------------------------------------------------------
+	double max = 0.0;
+	for (int j=firstCol; j<=lastCol; j+=2){
+		double value = (above[j] + below[j] + row[j-1] + row[j+1]) / 4.0;
+		if (omega != 1.0){
+			value = row[j] + omega*(value - row[j]);
+		}
+
+		double diff = fabs(value - row[j]);
+		if (diff > max){
+			max = diff;
+		}
+		row[j] = value;
+	}
+	return max;
+}
+
+
+double relaxRowRedBlackNorms(const double *above, double *row,
+                             const double *below, int firstCol,
+                             int lastCol,         double omega,
+                             struct changeNorms *norms){
+
+	//---------------------------------------------------------------
+    // relaxRowRedBlack that also adds to the sums in norms, for the
+    // sweeps whose convergence is checked by such a rule.
+    //---------------------------------------------------------------
+	double max = 0.0;
+	double sumSquares = 0.0;
+	double largest = norms->largest;
+	for (int j=firstCol; j<=lastCol; j+=2){
+		double value = (above[j] + below[j] + row[j-1] + row[j+1]) / 4.0;
+		if (omega != 1.0){
+			value = row[j] + omega*(value - row[j]);
+		}
+
+		double diff = fabs(value - row[j]);
+		if (diff > max){
+			max = diff;
+		}
+		sumSquares += diff*diff;
+		if (fabs(value) > largest){
+			largest = fabs(value);
+		}
+		row[j] = value;
+	}
+	norms->sumSquares += sumSquares;
+	norms->largest = largest;
+	return max;
+}
+
+
+double relaxRowsRedBlack(double **matrix, int rowFrom, int rowTo,
+                         int colFrom,     int colTo,
+                         int colour,      double omega){
+
+	//---------------------------------------------------------------
+    // Relaxes the cells of one colour in the given block in place, a
+    // cell is red (colour 0) when its row and column add up to an
+    // even number. Cells of one colour only read the other colour,
+    // so the block can be split between threads freely.
+    //---------------------------------------------------------------
+	double max = 0.0;
+	for (int i=rowFrom; i<=rowTo; i++){
+		int firstCol = ((i + colFrom + colour) % 2 == 0) ? colFrom : colFrom+1;
+
+		double diff = relaxRowRedBlack(matrix[i-1], matrix[i], matrix[i+1],
+		                               firstCol, colTo, omega);
+		if (diff > max){
+			max = diff;
+		}
+	}
+	return max;
+}
+
+
+double relaxRowsRedBlackNorms(double **matrix, int rowFrom, int rowTo,
+                              int colFrom,     int colTo,
+                              int colour,      double omega,
+                              struct changeNorms *norms){
+	//---------------------------------------------------------------
+    // relaxRowsRedBlack that also adds to the sums in norms
+    //---------------------------------------------------------------
+	double max = 0.0;
+	for (int i=rowFrom; i<=rowTo; i++){
+		int firstCol = ((i + colFrom + colour) % 2 == 0) ? colFrom : colFrom+1;
+
+		double diff = relaxRowRedBlackNorms(matrix[i-1], matrix[i], matrix[i+1],
+		                                    firstCol, colTo, omega, norms);
+		if (diff > max){
+			max = diff;
+		}
+	}
+	return max;
+}
@@ -0,0 +1,737 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "relax.h"
+
+#include "matrixWizard.c"
+#include "gridFile.c"
+#include "relaxKernel.c"
+#include "multigrid.c"
+#include "relaxSolver.c"
+
+
+//-------------------------------------------------------------------
+// The library build of the solver, behind the calls in relax.h. It
+// is built on its own into a shared library,
+//
+//     gcc relaxLibrary.c -o librelax.so -std=gnu99 -shared -fPIC
+//         -fvisibility=hidden -lpthread -lrt -lm -Wall -O2
+//
+// where only the RELAX_API calls are visible, or included whole by a
+// program as main.c includes the solver.
+//-------------------------------------------------------------------
+
+#define RELAX_ERROR_LENGTH 256
+
+//-------------------------------------------------------------------
+// The service protocol. Each request and reply is one message on a
+// SOCK_SEQPACKET socket, and a solve request carries the descriptor
+// of the client's shared grid alongside it. Options are name=value
+// pairs separated by spaces.
+//-------------------------------------------------------------------
+#define SERVICE_MAGIC 0x52454c58
+#define SERVICE_SOLVE 0
+#define SERVICE_STOP 1
+#define SERVICE_OPTIONS 1024
+#define SERVICE_CLIENTS 64
+#define SERVICE_BACKLOG 16
+
+
+struct relaxSolver {
+    //---------------------------------------------------------------
+    // The warm context, the options set so far, the copies of the
+    // strings they point to, and the row table put over the caller's
+    // cells, kept for the next solve of as many rows.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx;
+    struct relaxOptions options;
+    char **values;
+    int valueCount;
+    double **rowTable;
+    int tableRows;
+    char error[RELAX_ERROR_LENGTH];
+};
+
+struct relaxClient {
+    //---------------------------------------------------------------
+    // The connection to the server, and the shared grid the client
+    // fills, kept until a grid of a different size is asked for.
+    //---------------------------------------------------------------
+    int socket;
+    int gridFd;
+    double *cells;
+    size_t bytes;
+    int rows;
+    int cols;
+    char error[RELAX_ERROR_LENGTH];
+};
+
+struct serviceRequest {
+    unsigned int magic;
+    int kind;
+    int rows;
+    int cols;
+    double precision;
+    char options[SERVICE_OPTIONS];
+};
+
+struct serviceReply {
+    int status;
+    struct relaxInfo info;
+    char error[RELAX_ERROR_LENGTH];
+};
+
+struct serviceGrid {
+    //---------------------------------------------------------------
+    // A client's grid as the server has it mapped. Clients send the
+    // descriptor with every solve, and the mapping is kept while it
+    // is the same memory of the same size.
+    //---------------------------------------------------------------
+    dev_t device;
+    ino_t inode;
+    double *cells;
+    size_t bytes;
+};
+
+
+RELAX_API int relax_api_version(void){
+    return RELAX_API_VERSION;
+}
+
+
+RELAX_API struct relaxSolver *relax_solver_create(int threads){
+
+    if (threads < 1){
+        return NULL;
+    }
+    struct relaxSolver *solver = calloc(1, sizeof(struct relaxSolver));
+    if (solver == NULL){
+        return NULL;
+    }
+    solver->ctx = relax_context_create(threads);
+    solver->ctx->quiet = 1;
+    solver->ctx->keepFailures = 1;
+    solver->options = relax_default_options();
+    return solver;
+}
+
+
+RELAX_API void relax_solver_destroy(struct relaxSolver *solver){
+
+    if (solver == NULL){
+        return;
+    }
+    relax_context_destroy(solver->ctx);
+    for (int i=0; i<solver->valueCount; i++){
+        free(solver->values[i]);
+    }
+    free(solver->values);
+    free(solver->rowTable);
+    free(solver);
+}
+
+
+int solverFail(struct relaxSolver *solver, int status, const char *message){
+    snprintf(solver->error, RELAX_ERROR_LENGTH, "%s", message);
+    return status;
+}
+
+
+const char *processOptionProblem(const char *name){
+    //---------------------------------------------------------------
+    // The kernel is chosen once for the whole process, so one solver
+    // (or one request to the service) may not change it for others.
+    //---------------------------------------------------------------
+    if (strcmp(name, "kernel") == 0){
+        return "The kernel is chosen for the whole process, it can not be set on a solver.";
+    }
+    return NULL;
+}
+
+
+RELAX_API int relax_solver_set(struct relaxSolver *solver,
+                               const char *name, const char *value){
+
+    //---------------------------------------------------------------
+    // The options keep pointers to path and cpu list values, so the
+    // solver holds its own copy of every value it is given.
+    //---------------------------------------------------------------
+    if (name == NULL || value == NULL){
+        return solverFail(solver, RELAX_ERROR_ARGUMENT,
+                          "An option needs a name and a value.");
+    }
+    if (processOptionProblem(name) != NULL){
+        return solverFail(solver, RELAX_ERROR_OPTION,
+                          processOptionProblem(name));
+    }
+    char **values = realloc(solver->values,
+                            (solver->valueCount+1)*sizeof(char *));
+    if (values == NULL){
+        return solverFail(solver, RELAX_ERROR_MEMORY, "Out of memory.");
+    }
+    solver->values = values;
+    char *copy = strdup(value);
+    if (copy == NULL){
+        return solverFail(solver, RELAX_ERROR_MEMORY, "Out of memory.");
+    }
+    solver->values[solver->valueCount++] = copy;
+
+    struct relaxOptions options = solver->options;
+    const char *problem = relax_set_option(&options, name, copy);
+    if (problem == RELAX_UNKNOWN_OPTION){
+        snprintf(solver->error, RELAX_ERROR_LENGTH,
+                 "Unknown option '%s'.", name);
+        return RELAX_ERROR_OPTION;
+    }
+    if (problem != NULL){
+        return solverFail(solver, RELAX_ERROR_OPTION, problem);
+    }
+    solver->options = options;
+    return RELAX_OK;
+}
+
+
+RELAX_API const char *relax_solver_error(struct relaxSolver *solver){
+    return solver->error;
+}
+
+
+int solveWithOptions(struct relaxSolver *solver,
+                     struct relaxOptions *options, double *cells,
+                     int rows, int cols, double precision,
+                     struct relaxInfo *info){
+
+    //---------------------------------------------------------------
+    // Checks everything the solver would otherwise exit over, then
+    // solves the caller's cells in place through a row table. What
+    // the solve carried on past, such as a trace it could not write,
+    // is returned once it is done.
+    //---------------------------------------------------------------
+    int threads = solver->ctx->threads;
+    if (cells == NULL || rows < 3 || cols < 3){
+        return solverFail(solver, RELAX_ERROR_ARGUMENT,
+                          "A grid needs at least 3 rows and 3 columns.");
+    }
+    if (threads > rows-2 && threads > cols-2){
+        return solverFail(solver, RELAX_ERROR_ARGUMENT,
+                          "Matrix must have at least x+2 rows or columns to work with x threads.");
+    }
+    if (!(precision > 0.0)){
+        return solverFail(solver, RELAX_ERROR_ARGUMENT,
+                          "Precision must be above 0.");
+    }
+    const char *problem = relax_options_problem(options);
+    if (problem != NULL){
+        return solverFail(solver, RELAX_ERROR_OPTION, problem);
+    }
+
+    if (solver->tableRows < rows){
+        double **table = realloc(solver->rowTable, rows*sizeof(double *));
+        if (table == NULL){
+            return solverFail(solver, RELAX_ERROR_MEMORY, "Out of memory.");
+        }
+        solver->rowTable = table;
+        solver->tableRows = rows;
+    }
+    for (int i=0; i<rows; i++){
+        solver->rowTable[i] = cells + (size_t)i*cols;
+    }
+
+    double **matrix = solver->rowTable;
+    solver->ctx->options = *options;
+    solver->ctx->failure[0] = '\0';
+    double start = nowSeconds();
+    struct relaxResult result = relax_context_solve(solver->ctx, &matrix,
+                                                    rows, cols, precision);
+    if (info != NULL){
+        info->sweeps = result.sweeps;
+        info->cycles = result.cycles;
+        info->residual = result.residual;
+        info->stopReason = result.stopReason;
+        info->seconds = nowSeconds() - start;
+    }
+    if (solver->ctx->failure[0] != '\0'){
+        return solverFail(solver, RELAX_ERROR_SYSTEM, solver->ctx->failure);
+    }
+    solver->error[0] = '\0';
+    return RELAX_OK;
+}
+
+
+RELAX_API int relax_solver_solve(struct relaxSolver *solver, double *cells,
+                                 int rows, int cols, double precision,
+                                 struct relaxInfo *info){
+    return solveWithOptions(solver, &solver->options, cells, rows, cols,
+                            precision, info);
+}
+
+
+//-------------------------------------------------------------------
+// The server
+//-------------------------------------------------------------------
+int serviceListen(const char *socketPath){
+
+    //---------------------------------------------------------------
+    // Listens on the path, replacing a socket left by a server that
+    // did not stop cleanly. Only the user running the server may
+    // connect.
+    //---------------------------------------------------------------
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)){
+        return -1;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    int listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listener < 0){
+        return -1;
+    }
+    unlink(socketPath);
+    mode_t mask = umask(0077);
+    int bound = bind(listener, (struct sockaddr *)&address, sizeof(address));
+    umask(mask);
+    if (bound != 0 || listen(listener, SERVICE_BACKLOG) != 0){
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+
+int serviceReceive(int connection, struct serviceRequest *request, int *fd){
+
+    //---------------------------------------------------------------
+    // Receives one request and the descriptor sent with it, if any.
+    // Returns 0 once the client has gone.
+    //---------------------------------------------------------------
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec part = {request, sizeof(struct serviceRequest)};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    *fd = -1;
+    ssize_t got = recvmsg(connection, &message, MSG_CMSG_CLOEXEC);
+    if (got <= 0){
+        return 0;
+    }
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (header != NULL && header->cmsg_level == SOL_SOCKET &&
+        header->cmsg_type == SCM_RIGHTS){
+        memcpy(fd, CMSG_DATA(header), sizeof(int));
+    }
+    if (got != sizeof(struct serviceRequest) ||
+        request->magic != SERVICE_MAGIC){
+        return -1;
+    }
+    request->options[SERVICE_OPTIONS-1] = '\0';
+    return 1;
+}
+
+
+void serviceForget(struct serviceGrid *grid){
+    if (grid->cells != NULL){
+        munmap(grid->cells, grid->bytes);
+    }
+    memset(grid, 0, sizeof(struct serviceGrid));
+}
+
+
+double *serviceMap(struct serviceGrid *grid, int fd, size_t bytes){
+
+    //---------------------------------------------------------------
+    // Maps the client's grid, or reuses the mapping from its last
+    // solve when the descriptor is for the same memory. The memory
+    // must be sealed against shrinking and growing, or the client
+    // could cut it short mid solve and the server would fault.
+    //---------------------------------------------------------------
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & (F_SEAL_SHRINK | F_SEAL_GROW)) !=
+                     (F_SEAL_SHRINK | F_SEAL_GROW)){
+        return NULL;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || (size_t)status.st_size < bytes){
+        return NULL;
+    }
+    if (grid->cells != NULL && grid->device == status.st_dev &&
+        grid->inode == status.st_ino && grid->bytes == bytes){
+        return grid->cells;
+    }
+    serviceForget(grid);
+    double *cells = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         fd, 0);
+    if (cells == MAP_FAILED){
+        return NULL;
+    }
+    grid->device = status.st_dev;
+    grid->inode = status.st_ino;
+    grid->cells = cells;
+    grid->bytes = bytes;
+    return cells;
+}
+
+
+void serviceSolve(struct relaxSolver *solver, struct serviceGrid *grid,
+                  struct serviceRequest *request, int fd,
+                  struct serviceReply *reply){
+
+    //---------------------------------------------------------------
+    // Applies the request's options over the solver's own, for this
+    // solve only, then solves the client's grid where it lies. The
+    // option strings stay in the request until the solve is done.
+    //---------------------------------------------------------------
+    struct relaxOptions options = solver->options;
+    char *save = NULL;
+    for (char *pair = strtok_r(request->options, " ", &save); pair != NULL;
+         pair = strtok_r(NULL, " ", &save)){
+        char *value = strchr(pair, '=');
+        if (value == NULL){
+            snprintf(reply->error, RELAX_ERROR_LENGTH,
+                     "Option '%s' should be given as name=value.", pair);
+            reply->status = RELAX_ERROR_OPTION;
+            return;
+        }
+        *value = '\0';
+        value++;
+        const char *problem = processOptionProblem(pair);
+        if (problem == NULL){
+            problem = relax_set_option(&options, pair, value);
+        }
+        if (problem == RELAX_UNKNOWN_OPTION){
+            snprintf(reply->error, RELAX_ERROR_LENGTH,
+                     "Unknown option '%s'.", pair);
+            reply->status = RELAX_ERROR_OPTION;
+            return;
+        }
+        if (problem != NULL){
+            snprintf(reply->error, RELAX_ERROR_LENGTH, "%s", problem);
+            reply->status = RELAX_ERROR_OPTION;
+            return;
+        }
+    }
+
+    if (request->rows < 3 || request->cols < 3){
+        snprintf(reply->error, RELAX_ERROR_LENGTH,
+                 "A grid needs at least 3 rows and 3 columns.");
+        reply->status = RELAX_ERROR_ARGUMENT;
+        return;
+    }
+    size_t bytes = (size_t)request->rows*request->cols*sizeof(double);
+    double *cells = (fd < 0) ? NULL : serviceMap(grid, fd, bytes);
+    if (cells == NULL){
+        snprintf(reply->error, RELAX_ERROR_LENGTH,
+                 "Could not map the shared grid, it must be a sealed "
+                 "memfd of the grid's size.");
+        reply->status = RELAX_ERROR_ARGUMENT;
+        return;
+    }
+
+    reply->status = solveWithOptions(solver, &options, cells, request->rows,
+                                     request->cols, request->precision,
+                                     &reply->info);
+    snprintf(reply->error, RELAX_ERROR_LENGTH, "%s", solver->error);
+}
+
+
+RELAX_API int relax_serve(struct relaxSolver *solver, const char *socketPath){
+
+    //---------------------------------------------------------------
+    // Polls the listening socket and every client, solving requests
+    // one at a time on the solver's threads as they arrive, so a
+    // client that is idle holds no one else up.
+    //---------------------------------------------------------------
+    int listener = serviceListen(socketPath);
+    if (listener < 0){
+        snprintf(solver->error, RELAX_ERROR_LENGTH,
+                 "Could not listen on '%s': %s.", socketPath, strerror(errno));
+        return RELAX_ERROR_CONNECTION;
+    }
+
+    struct pollfd polls[SERVICE_CLIENTS+1];
+    struct serviceGrid grids[SERVICE_CLIENTS+1];
+    memset(grids, 0, sizeof(grids));
+    int count = 1;
+    polls[0].fd = listener;
+    polls[0].events = POLLIN;
+
+    int serving = 1;
+    while (serving){
+        if (poll(polls, count, -1) < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            break;
+        }
+
+        for (int c=count-1; c>=1; c--){
+            if (polls[c].revents == 0){
+                continue;
+            }
+            struct serviceRequest request;
+            struct serviceReply reply;
+            memset(&reply, 0, sizeof(reply));
+            int fd;
+            int got = serviceReceive(polls[c].fd, &request, &fd);
+
+            if (got == 1 && request.kind == SERVICE_STOP){
+                serving = 0;
+            }
+            else if (got == 1){
+                serviceSolve(solver, &grids[c], &request, fd, &reply);
+            }
+            else if (got < 0){
+                reply.status = RELAX_ERROR_CONNECTION;
+                snprintf(reply.error, RELAX_ERROR_LENGTH,
+                         "The request was not understood.");
+            }
+            if (fd >= 0){
+                close(fd);
+            }
+
+            if (got == 0 ||
+                send(polls[c].fd, &reply, sizeof(reply), MSG_NOSIGNAL) < 0){
+                close(polls[c].fd);
+                serviceForget(&grids[c]);
+                count--;
+                polls[c] = polls[count];
+                grids[c] = grids[count];
+                memset(&grids[count], 0, sizeof(struct serviceGrid));
+            }
+        }
+
+        if (polls[0].revents & POLLIN){
+            int connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+            if (connection >= 0 && count <= SERVICE_CLIENTS){
+                polls[count].fd = connection;
+                polls[count].events = POLLIN;
+                polls[count].revents = 0;
+                count++;
+            }
+            else if (connection >= 0){
+                close(connection);
+            }
+        }
+    }
+
+    for (int c=1; c<count; c++){
+        close(polls[c].fd);
+        serviceForget(&grids[c]);
+    }
+    close(listener);
+    unlink(socketPath);
+    return RELAX_OK;
+}
+
+
+//-------------------------------------------------------------------
+// The client
+//-------------------------------------------------------------------
+RELAX_API struct relaxClient *relax_client_connect(const char *socketPath){
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)){
+        return NULL;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    int connection = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (connection < 0){
+        return NULL;
+    }
+    if (connect(connection, (struct sockaddr *)&address, sizeof(address)) != 0){
+        close(connection);
+        return NULL;
+    }
+
+    struct relaxClient *client = calloc(1, sizeof(struct relaxClient));
+    if (client == NULL){
+        close(connection);
+        return NULL;
+    }
+    client->socket = connection;
+    client->gridFd = -1;
+    return client;
+}
+
+
+RELAX_API double *relax_client_grid(struct relaxClient *client,
+                                    int rows, int cols){
+
+    //---------------------------------------------------------------
+    // The grid is an anonymous memory file, so it can be handed to
+    // the server and mapped there without touching the disk.
+    //---------------------------------------------------------------
+    if (rows < 3 || cols < 3){
+        snprintf(client->error, RELAX_ERROR_LENGTH,
+                 "A grid needs at least 3 rows and 3 columns.");
+        return NULL;
+    }
+    if (client->cells != NULL && client->rows == rows && client->cols == cols){
+        return client->cells;
+    }
+    if (client->cells != NULL){
+        munmap(client->cells, client->bytes);
+        close(client->gridFd);
+        client->cells = NULL;
+        client->gridFd = -1;
+    }
+
+    size_t bytes = (size_t)rows*cols*sizeof(double);
+    int fd = memfd_create("relax-grid", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0 || ftruncate(fd, bytes) != 0 ||
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) != 0){
+        snprintf(client->error, RELAX_ERROR_LENGTH,
+                 "Could not make a shared grid: %s.", strerror(errno));
+        if (fd >= 0){
+            close(fd);
+        }
+        return NULL;
+    }
+    double *cells = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         fd, 0);
+    if (cells == MAP_FAILED){
+        snprintf(client->error, RELAX_ERROR_LENGTH,
+                 "Could not map a shared grid: %s.", strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    client->gridFd = fd;
+    client->cells = cells;
+    client->bytes = bytes;
+    client->rows = rows;
+    client->cols = cols;
+    return cells;
+}
+
+
+int clientRequest(struct relaxClient *client, struct serviceRequest *request,
+                  int fd, struct serviceReply *reply){
+
+    //---------------------------------------------------------------
+    // Sends a request, with the descriptor when there is one, and
+    // waits for the reply.
+    //---------------------------------------------------------------
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct iovec part = {request, sizeof(struct serviceRequest)};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    if (fd >= 0){
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(header), &fd, sizeof(int));
+    }
+
+    if (sendmsg(client->socket, &message, MSG_NOSIGNAL) < 0){
+        snprintf(client->error, RELAX_ERROR_LENGTH,
+                 "Could not reach the server: %s.", strerror(errno));
+        return RELAX_ERROR_CONNECTION;
+    }
+    if (reply == NULL){
+        return RELAX_OK;
+    }
+    if (recv(client->socket, reply, sizeof(struct serviceReply), 0) !=
+        sizeof(struct serviceReply)){
+        snprintf(client->error, RELAX_ERROR_LENGTH,
+                 "The server went away during the solve.");
+        return RELAX_ERROR_CONNECTION;
+    }
+    return RELAX_OK;
+}
+
+
+RELAX_API int relax_client_solve(struct relaxClient *client,
+                                 double precision, const char *options,
+                                 struct relaxInfo *info){
+
+    if (client->cells == NULL){
+        snprintf(client->error, RELAX_ERROR_LENGTH,
+                 "There is no grid to solve, ask for one first.");
+        return RELAX_ERROR_ARGUMENT;
+    }
+    struct serviceRequest request;
+    memset(&request, 0, sizeof(request));
+    request.magic = SERVICE_MAGIC;
+    request.kind = SERVICE_SOLVE;
+    request.rows = client->rows;
+    request.cols = client->cols;
+    request.precision = precision;
+    if (options != NULL){
+        if (strlen(options) >= SERVICE_OPTIONS){
+            snprintf(client->error, RELAX_ERROR_LENGTH,
+                     "Options must be under %d characters.", SERVICE_OPTIONS);
+            return RELAX_ERROR_OPTION;
+        }
+        strcpy(request.options, options);
+    }
+
+    struct serviceReply reply;
+    int status = clientRequest(client, &request, client->gridFd, &reply);
+    if (status != RELAX_OK){
+        return status;
+    }
+    if (info != NULL){
+        *info = reply.info;
+    }
+    snprintf(client->error, RELAX_ERROR_LENGTH, "%s", reply.error);
+    return reply.status;
+}
+
+
+RELAX_API int relax_client_stop_server(struct relaxClient *client){
+
+    struct serviceRequest request;
+    memset(&request, 0, sizeof(request));
+    request.magic = SERVICE_MAGIC;
+    request.kind = SERVICE_STOP;
+    return clientRequest(client, &request, -1, NULL);
+}
+
+
+RELAX_API const char *relax_client_error(struct relaxClient *client){
+    return client->error;
+}
+
+
+RELAX_API void relax_client_close(struct relaxClient *client){
+
+    if (client == NULL){
+        return;
+    }
+    if (client->cells != NULL){
+        munmap(client->cells, client->bytes);
+        close(client->gridFd);
+    }
+    close(client->socket);
+    free(client);
+}
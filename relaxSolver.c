@@ -0,0 +1,5016 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+
+//---------------------------------------------------------------
+// How the parallel solver decides it has converged.
+//   FLAGS  - each thread raises a flag once its rows settle, three
+//            barriers per sweep.
+//   REDUCE - each thread publishes its largest change into its own
+//            cache line and they are combined with an atomic max,
+//            one barrier per sweep.
+//   ASYNC  - threads sweep their bands in place over and over with
+//            no barriers, reading whatever their neighbours last
+//            wrote, until a full round of sweeps moves no cell by
+//            more than the precision. Not deterministic.
+//---------------------------------------------------------------
+#define CONVERGE_FLAGS 0
+#define CONVERGE_REDUCE 1
+#define CONVERGE_ASYNC 2
+
+//---------------------------------------------------------------
+// The update rule used on each sweep.
+//   JACOBI - every cell becomes the average of its neighbours from
+//            the previous sweep, needs a second matrix.
+//   GS     - red black Gauss Seidel, updates cells of one colour in
+//            place from the newest values of the other colour.
+//   SOR    - red black Gauss Seidel over relaxed by omega.
+//   MULTIGRID - V or F cycles with red black Gauss Seidel smoothing,
+//            stopping once a Jacobi sweep would change no cell by
+//            more than the precision.
+//---------------------------------------------------------------
+#define METHOD_JACOBI 0
+#define METHOD_GS 1
+#define METHOD_SOR 2
+#define METHOD_MULTIGRID 3
+
+//---------------------------------------------------------------
+// How the rows of each sweep are shared between threads.
+//   STATIC - each thread keeps its band from getAssignedRows, a
+//            band of whole rows, or of whole columns when that
+//            shares the cells out more evenly.
+//   STEAL  - each sweep is cut into chunks of rows, each thread
+//            starts on the chunks of its own band and then steals
+//            from the far end of other threads' chunks.
+//---------------------------------------------------------------
+#define SCHEDULE_STATIC 0
+#define SCHEDULE_STEAL 1
+
+//---------------------------------------------------------------
+// Where Jacobi threads get the rows next to their band from.
+//   SHARED - everyone sweeps the one shared pair of matrices, and
+//            waits at a barrier every sweep.
+//   HALO   - each thread sweeps a private copy of its band with
+//            ghost rows around it, swapping edge rows with just its
+//            two neighbours every ghost depth sweeps.
+//---------------------------------------------------------------
+#define EXCHANGE_SHARED 0
+#define EXCHANGE_HALO 1
+
+//---------------------------------------------------------------
+// The type the Jacobi sweeps are done in.
+//   DOUBLE - every sweep in doubles.
+//   FLOAT  - every sweep in floats, half the memory traffic, but
+//            it can not settle much below float rounding.
+//   MIXED  - sweeps in floats until they settle, or reach float
+//            rounding, then finishes in doubles.
+//---------------------------------------------------------------
+#define DTYPE_DOUBLE 0
+#define DTYPE_FLOAT 1
+#define DTYPE_MIXED 2
+
+//---------------------------------------------------------------
+// Rounding can leave float sweeps cycling between a few values
+// above the precision forever, so the float sweeps also stop once
+// this many sweeps in a row find no smaller change than before.
+//---------------------------------------------------------------
+#define FLOAT_STALL_SWEEPS 1000
+
+#define CACHE_LINE 64
+
+//---------------------------------------------------------------
+// The longest failure message a context keeps for its caller.
+//---------------------------------------------------------------
+#define FAILURE_LENGTH 256
+
+//---------------------------------------------------------------
+// The parts of a sweep that profiling times separately.
+//   COMPUTE - relaxing cells, which measures their change too as
+//             the kernels do both in one pass
+//   CHECK   - publishing and combining the changes to test for
+//             convergence
+//   BARRIER - waiting at barriers for the other threads
+//   SERIAL  - work one thread does for all, such as swapping the
+//             shared matrix pointers
+//---------------------------------------------------------------
+#define PHASE_COMPUTE 0
+#define PHASE_CHECK 1
+#define PHASE_BARRIER 2
+#define PHASE_SERIAL 3
+#define PHASE_COUNT 4
+
+//---------------------------------------------------------------
+// The most timeline events kept per thread for a trace, about 24MB
+// each, any after that only count towards the totals.
+//---------------------------------------------------------------
+#define TRACE_MAX_EVENTS (1 << 20)
+
+//---------------------------------------------------------------
+// Grids of a batch with no more cells than this are solved whole
+// by one thread, larger ones are shared out by rows as usual.
+//---------------------------------------------------------------
+#define BATCH_WHOLE_CELLS (512*512)
+
+//---------------------------------------------------------------
+// What a checked sweep is measured by to decide it has settled.
+//   CHANGE   - the largest change of any cell
+//   RMS      - the root mean square change over the interior
+//   RELATIVE - the largest change over the largest value in the
+//              matrix, for matrices whose scale is not known
+//---------------------------------------------------------------
+#define STOP_CHANGE 0
+#define STOP_RMS 1
+#define STOP_RELATIVE 2
+
+//---------------------------------------------------------------
+// Why a solve stopped, kept in its result.
+//---------------------------------------------------------------
+#define STOPPED_SETTLED 0
+#define STOPPED_SWEEPS 1
+#define STOPPED_TIME 2
+#define STOPPED_STAGNATED 3
+
+//---------------------------------------------------------------
+// A solve stagnates when its stopping norm has not fallen below
+// this fraction of its lowest mark for the given number of sweeps.
+//---------------------------------------------------------------
+#define STAGNATION_FACTOR 0.99
+
+
+struct relaxOptions {
+    //---------------------------------------------------------------
+    // Tunables for the parallel solver, a context copies the
+    // defaults on creation and callers may change them between
+    // solves.
+    //---------------------------------------------------------------
+    int method;
+    double omega;
+    int convergence;
+    int checkEvery;
+
+    //---------------------------------------------------------------
+    // Temporal blocking, when depth is above zero the matrix is cut
+    // into tileRows x tileCols tiles that are each swept depth times
+    // while they sit in cache.
+    //---------------------------------------------------------------
+    int temporalDepth;
+    int tileRows;
+    int tileCols;
+
+    //---------------------------------------------------------------
+    // Volumes are swept in tiles of volumeTileRows x volumeTileCols
+    // through every plane, sized so the three planes of a tile that
+    // each row reads fit in a core's L2 cache.
+    //---------------------------------------------------------------
+    int volumeTileRows;
+    int volumeTileCols;
+
+    //---------------------------------------------------------------
+    // Multigrid cycle shape, and the number of smoothing sweeps done
+    // before and after each coarse grid correction.
+    //---------------------------------------------------------------
+    int cycle;
+    int smoothing;
+
+    //---------------------------------------------------------------
+    // Row scheduling, and the rows in each chunk when stealing.
+    //---------------------------------------------------------------
+    int schedule;
+    int chunkRows;
+
+    //---------------------------------------------------------------
+    // How bands get their neighbours' rows, and the number of ghost
+    // rows each side of a band when they are exchanged.
+    //---------------------------------------------------------------
+    int exchange;
+    int ghostDepth;
+
+    //---------------------------------------------------------------
+    // Memory placement. With numa each thread first touches its own
+    // rows of the scratch matrix, hugePages backs it with 2MB pages,
+    // and cpuList (eg "0-7,16-23") pins thread i to the i'th cpu of
+    // the list, wrapping round.
+    //---------------------------------------------------------------
+    int numa;
+    int hugePages;
+    const char *cpuList;
+
+    //---------------------------------------------------------------
+    // Checkpoints. When checkpointPath is set the matrix is written
+    // there every checkpointEvery sweeps by a background thread,
+    // sweepsBefore being the sweeps already done by the run this
+    // solve resumes, so the counts in the files carry on from it.
+    //---------------------------------------------------------------
+    const char *checkpointPath;
+    int checkpointEvery;
+    long sweepsBefore;
+
+    //---------------------------------------------------------------
+    // When re-solving after a boundary change, only relax the rows
+    // the change has reached and that are still moving.
+    //---------------------------------------------------------------
+    int incremental;
+
+    int dataType;
+
+    //---------------------------------------------------------------
+    // Profiling. With profile set each thread times the phases of
+    // its sweeps and the largest change of each checked sweep is
+    // kept, and a summary is printed after the solve. tracePath
+    // also keeps every phase as an event and writes them out as a
+    // Chrome trace after each solve.
+    //---------------------------------------------------------------
+    int profile;
+    const char *tracePath;
+
+    //---------------------------------------------------------------
+    // When to stop. stopRule picks the norm held to the precision,
+    // and when above zero a solve also gives up after maxSweeps
+    // sweeps, after maxSeconds, or once the norm has not fallen by
+    // 1% in stagnationSweeps sweeps. historyPath, when set, has the
+    // norm of every checked sweep written to it after each solve.
+    //---------------------------------------------------------------
+    int stopRule;
+    int maxSweeps;
+    double maxSeconds;
+    int stagnationSweeps;
+    const char *historyPath;
+
+    //---------------------------------------------------------------
+    // The equation solved, Laplace's when NULL. It belongs to the
+    // caller, who keeps it alive for the solves that use it.
+    //---------------------------------------------------------------
+    const struct relaxProblem *problem;
+
+    //---------------------------------------------------------------
+    // The interior cells held fixed, none when NULL. It also belongs
+    // to the caller, and threads are given bands of about the same
+    // number of active cells.
+    //---------------------------------------------------------------
+    const struct cellMask *mask;
+};
+
+struct relaxResult {
+    //---------------------------------------------------------------
+    // What a solve achieved, the number of sweeps it took, the
+    // largest change of any cell on the last checked sweep and why
+    // it stopped.
+    //---------------------------------------------------------------
+    int sweeps;
+    double residual;
+    int cycles;
+    int stopReason;
+};
+
+struct relaxGrid {
+    //---------------------------------------------------------------
+    // One grid of a batch, solved in place, and what its solve
+    // achieved.
+    //---------------------------------------------------------------
+    double **matrix;
+    int rows;
+    int cols;
+    struct relaxResult result;
+};
+
+struct paddedResidual {
+    //---------------------------------------------------------------
+    // A residual on its own cache line, so threads publishing them
+    // side by side do not invalidate each other's lines.
+    //---------------------------------------------------------------
+    double value;
+    unsigned long long maxBits;
+    char padding[CACHE_LINE - sizeof(double) - sizeof(unsigned long long)];
+} __attribute__((aligned(CACHE_LINE)));
+
+
+struct chunkQueue {
+    //---------------------------------------------------------------
+    // The chunks a thread has left this sweep, packed as the next
+    // chunk in the high half and one past the last in the low half
+    // so the owner and thieves can both take with one compare and
+    // swap.
+    //---------------------------------------------------------------
+    unsigned long long range;
+    char padding[CACHE_LINE - sizeof(unsigned long long)];
+} __attribute__((aligned(CACHE_LINE)));
+
+struct activeRows {
+    //---------------------------------------------------------------
+    // The first and last row a thread changed by more than the
+    // precision on a sweep, first > last when it changed none, and
+    // the largest change it made.
+    //---------------------------------------------------------------
+    int first;
+    int last;
+    double residual;
+    char padding[CACHE_LINE - 2*sizeof(int) - sizeof(double)];
+} __attribute__((aligned(CACHE_LINE)));
+
+struct threadStats {
+    //---------------------------------------------------------------
+    // How one thread spent a solve, to show how balanced it was.
+    //---------------------------------------------------------------
+    double busySeconds;
+    double waitSeconds;
+    long chunks;
+    long steals;
+    char padding[CACHE_LINE - 2*sizeof(double) - 2*sizeof(long)];
+} __attribute__((aligned(CACHE_LINE)));
+
+
+struct phaseStats {
+    //---------------------------------------------------------------
+    // Seconds one thread spent in each phase during the last solve
+    //---------------------------------------------------------------
+    double seconds[PHASE_COUNT];
+    char padding[CACHE_LINE - PHASE_COUNT*sizeof(double)];
+} __attribute__((aligned(CACHE_LINE)));
+
+struct traceEvent {
+    //---------------------------------------------------------------
+    // One phase of one thread, in seconds since profiling started
+    //---------------------------------------------------------------
+    double start;
+    double end;
+    int phase;
+};
+
+struct paddedCounter {
+    //---------------------------------------------------------------
+    // A counter on its own cache line, written by one thread and
+    // waited on by another.
+    //---------------------------------------------------------------
+    int value;
+    char padding[CACHE_LINE - sizeof(int)];
+} __attribute__((aligned(CACHE_LINE)));
+
+struct asyncProgress {
+    //---------------------------------------------------------------
+    // A thread's progress in asynchronous mode, the sweeps it has
+    // done, how many of them moved a cell by more than the precision
+    // and the largest change on its last.
+    //---------------------------------------------------------------
+    int sweeps;
+    int moved;
+    double change;
+    char padding[CACHE_LINE - 2*sizeof(int) - sizeof(double)];
+} __attribute__((aligned(CACHE_LINE)));
+
+struct matrixTask {
+    //---------------------------------------------------------------
+    // A fill, copy or comparison of whole matrices, shared between
+    // the pool's threads by rows.
+    //---------------------------------------------------------------
+    double **from;
+    double **to;
+    int rows;
+    int cols;
+    double min;
+    double max;
+    unsigned int seed;
+    double precision;
+    struct volume *fromVolume;
+    struct volume *toVolume;
+};
+
+struct paddedNorms {
+    //---------------------------------------------------------------
+    // A thread's change norms on its own cache line.
+    //---------------------------------------------------------------
+    struct changeNorms norms;
+    char padding[CACHE_LINE - sizeof(struct changeNorms)];
+} __attribute__((aligned(CACHE_LINE)));
+
+struct stopState {
+    //---------------------------------------------------------------
+    // The lowest norm stagnation is measured from and the sweep it
+    // was reached on.
+    //---------------------------------------------------------------
+    double mark;
+    int markCount;
+};
+
+struct residualSample {
+    double time;
+    int sweep;
+    double residual;
+};
+
+
+struct assignedRows {
+    //---------------------------------------------------------------
+    // Stores data for row assignment. When byColumns is set every
+    // thread has all the interior rows and a band of the columns.
+    //---------------------------------------------------------------
+    int *assignedStartRow;
+    int *assignedNumberOfRows;
+    int *assignedStartCol;
+    int *assignedNumberOfCols;
+    int byColumns;
+};
+
+struct thread_args{
+    //---------------------------------------------------------------
+    // Encapsulates the arguments passed to a thread
+    //---------------------------------------------------------------
+    double ***matrix;
+    double ***lastMatrix;
+    float ***floatMatrix;
+    float ***floatLastMatrix;
+    int **rowsComplete;
+    pthread_barrier_t *barrier;
+    struct relaxContext *context;
+
+    int threadNumber;
+    int totalThreads;
+    int rows;
+    int cols;
+    int rowFrom;
+    int rowTo;
+    int colFrom;
+    int colTo;
+    int planeFrom;
+    int planeTo;
+    double precision;
+
+    //---------------------------------------------------------------
+    // Work grids for grids this thread solves whole in a batch, the
+    // first also its spare row in asynchronous mode, kept from solve
+    // to solve and only regrown when a grid needs more.
+    //---------------------------------------------------------------
+    struct grid work[2];
+
+    //---------------------------------------------------------------
+    // This thread's trace events, only kept with a trace path.
+    //---------------------------------------------------------------
+    struct traceEvent *events;
+    int eventCount;
+    int eventCapacity;
+
+    //---------------------------------------------------------------
+    // Halo exchange. The thread's own pair of subgrids, its band
+    // with the ghost rows either side, and the mailboxes it passes
+    // its top and bottom edge rows to its neighbours in, two of each
+    // so one can be read while the next is filled.
+    //---------------------------------------------------------------
+    double **halo[2];
+    int haloRows;
+    int haloCols;
+    double *mailTop[2];
+    double *mailBottom[2];
+    size_t mailCells;
+};
+
+struct relaxContext {
+    //---------------------------------------------------------------
+    // A pool of worker threads, with their barriers and scratch
+    // buffers, that is kept alive across many solves. The thread
+    // calling 'relax_context_solve' acts as the last worker, so a
+    // context of n threads only ever starts n-1 pthreads.
+    //---------------------------------------------------------------
+    int threads;
+    pthread_t *workers;
+    pthread_barrier_t barrier;
+    pthread_barrier_t jobBarrier;
+    struct thread_args *args;
+    void (*job)(struct thread_args *p);
+    int shutdown;
+    struct relaxOptions options;
+
+    //---------------------------------------------------------------
+    // Per thread residuals and the three rotating slots they are
+    // reduced into for the REDUCE convergence mode.
+    //---------------------------------------------------------------
+    struct paddedResidual *residuals;
+    struct paddedResidual reduction[3];
+    struct relaxResult result;
+
+    //---------------------------------------------------------------
+    // Stopping rules. Each thread's norms for two sweeps, when the
+    // rule needs more than the largest change, and whether the time
+    // budget was spent by each of the three sweeps in flight, as
+    // thread 0 saw it against solveStart.
+    //---------------------------------------------------------------
+    struct paddedNorms *norms;
+    int budgetSpent[3];
+    double solveStart;
+
+    //---------------------------------------------------------------
+    // Scratch matrix and row assignment, rebuilt only when a solve
+    // asks for a different size to the previous one.
+    //---------------------------------------------------------------
+    double **lastMatrix;
+    int lastMatrixMapped;
+    int lastMatrixHugePages;
+    int *rowsComplete;
+    struct assignedRows AR;
+    int rows;
+    int cols;
+    const struct cellMask *assignedMask;
+
+    //---------------------------------------------------------------
+    // The cpu list the threads are pinned to, the context's own copy
+    // or NULL when they are not, and the cpus the process could run
+    // on when the context was made, to go back to when unpinned.
+    //---------------------------------------------------------------
+    char *pinnedCpuList;
+    cpu_set_t startAffinity;
+
+    //---------------------------------------------------------------
+    // Temporal blocking state, a private pair of tile buffers per
+    // thread, each thread's largest change on every sweep of a block
+    // (for two blocks at a time), and the counters threads take
+    // tiles from.
+    //---------------------------------------------------------------
+    double **tileBuffers;
+    size_t tileBufferLength;
+    double *sweepResiduals;
+    int sweepStride;
+    struct paddedResidual tileCounter[2];
+
+    //---------------------------------------------------------------
+    // Multigrid levels, finest first, made for the size they were
+    // last built at.
+    //---------------------------------------------------------------
+    struct multigridLevel *levels;
+    int levelCount;
+    int levelRows;
+    int levelCols;
+
+    //---------------------------------------------------------------
+    // Work stealing queues, one per thread for each of two sweeps,
+    // and each thread's statistics from the last solve.
+    //---------------------------------------------------------------
+    struct chunkQueue *queues;
+    struct threadStats *stats;
+
+    //---------------------------------------------------------------
+    // Checkpoint state. Threads copy their band into the buffer on
+    // the sweep after one is due, then the writer thread takes it
+    // to disk while they carry on. checkpointDue holds the sweep due
+    // for each parity of sweep, or -1, and checkpointHeader is what
+    // goes on the front of the file, callers may fill in boundary.
+    //---------------------------------------------------------------
+    double **checkpointBuffer;
+    int checkpointRows;
+    int checkpointCols;
+    long checkpointDue[2];
+    int checkpointBusy;
+    int checkpointWriterStarted;
+    long checkpointsWritten;
+    struct gridHeader checkpointHeader;
+    pthread_t checkpointWriter;
+    pthread_mutex_t checkpointLock;
+    pthread_cond_t checkpointChanged;
+
+    //---------------------------------------------------------------
+    // Incremental re-solves relax only the window of rows from
+    // windowFrom to windowTo, which follows the rows still moving.
+    // active holds each thread's moving rows for two sweeps.
+    //---------------------------------------------------------------
+    int windowed;
+    int windowFrom;
+    int windowTo;
+    struct activeRows *active;
+
+    //---------------------------------------------------------------
+    // Halo exchange counters. haloPublished holds the last exchange
+    // each thread has put its edge rows out for, haloTakenAbove and
+    // haloTakenBelow the last its neighbours above and below have
+    // copied. haloArrived counts the threads whose change is in each
+    // of the reduction slots.
+    //---------------------------------------------------------------
+    struct paddedCounter *haloPublished;
+    struct paddedCounter *haloTakenAbove;
+    struct paddedCounter *haloTakenBelow;
+    struct paddedCounter haloArrived[3];
+
+    //---------------------------------------------------------------
+    // Asynchronous mode. Each thread's progress, and thread 0's mark
+    // of everyone's sweeps and moved sweeps that termination is
+    // judged from, in asyncMark, when asyncMarked is set.
+    //---------------------------------------------------------------
+    struct asyncProgress *progress;
+    int *asyncMark;
+    int asyncMarked;
+    int asyncDone;
+
+    //---------------------------------------------------------------
+    // The fill, copy or comparison the threads are sharing, when not
+    // solving.
+    //---------------------------------------------------------------
+    struct matrixTask task;
+
+    //---------------------------------------------------------------
+    // Volumes. The one being solved, the scratch volume kept for the
+    // next solve of its size, and how the threads split it, into
+    // slabs of planes each cut into pencils of rows.
+    //---------------------------------------------------------------
+    struct volume *volume;
+    struct volume lastVolume;
+    int volumePlaneParts;
+    int volumeRowParts;
+
+    //---------------------------------------------------------------
+    // Float copies of the matrix for the float and mixed types.
+    //---------------------------------------------------------------
+    float **floatMatrix;
+    float **floatLastMatrix;
+    int floatRows;
+    int floatCols;
+
+    //---------------------------------------------------------------
+    // Batches. batchOrder lists the grids to solve whole, largest
+    // first, and threads take the next from batchNext. quiet stops
+    // solves printing their progress.
+    //---------------------------------------------------------------
+    struct relaxGrid *batch;
+    int *batchOrder;
+    int batchWhole;
+    double batchPrecision;
+    struct paddedResidual batchNext;
+    int quiet;
+
+    //---------------------------------------------------------------
+    // What went wrong that a solve carried on past, such as a trace
+    // or checkpoint that could not be written. With keepFailures the
+    // first is kept in failure for the caller to return, otherwise
+    // each is printed.
+    //---------------------------------------------------------------
+    int keepFailures;
+    char failure[FAILURE_LENGTH];
+
+    //---------------------------------------------------------------
+    // Profiling state, set from the options at the start of every
+    // solve. Trace events and residuals are emptied at the start of
+    // every recorded solve, so they hold only the last one, and are
+    // timed from profileOrigin. recording is set when either
+    // profiling or a history needs the residuals.
+    // residualSweepBase is added to each sweep recorded, so the
+    // double sweeps of a mixed solve follow on from its float ones.
+    //---------------------------------------------------------------
+    int profiling;
+    int recording;
+    double profileOrigin;
+    struct phaseStats *phases;
+    struct residualSample *residualHistory;
+    int residualCount;
+    int residualCapacity;
+    int residualSweepBase;
+};
+
+
+
+void spreadEvenly(int first, int items, int threads,
+                  int *start, int *number){
+
+    //---------------------------------------------------------------
+    // Each thread is incrementally given items until all of them
+    // are assigned, then the item each thread is to start from is
+    // worked out from the counts before it.
+    //---------------------------------------------------------------
+    for (int i=0; i<threads; i++){
+        number[i] = 0;
+    }
+
+    int threadToIncrement = 0;
+    for (int i=0; i<items; i++){
+
+        number[threadToIncrement]++;
+
+        threadToIncrement++;
+        if (threadToIncrement >= threads){
+            threadToIncrement = 0;
+        }
+    }
+
+    for (int i=0; i<threads; i++){
+        start[i] = first;
+        first = first + number[i];
+    }
+}
+
+
+int relaxSplitsByColumns(int rows, int cols, int threads){
+
+    //---------------------------------------------------------------
+    // Bands of whole rows keep every thread's rows contiguous, so
+    // columns are only used when there are too few rows, or when the
+    // biggest column band is a smaller share of the columns than the
+    // biggest row band is of the rows, as on a short wide matrix.
+    //---------------------------------------------------------------
+    int workableRows = rows - 2;
+    int workableCols = cols - 2;
+    if (threads > workableRows){
+        return 1;
+    }
+    if (threads <= workableCols){
+        long rowShare = (workableRows + threads - 1) / threads;
+        long colShare = (workableCols + threads - 1) / threads;
+        return (rowShare*workableCols > colShare*workableRows);
+    }
+    return 0;
+}
+
+
+struct assignedRows getAssignedRows(int rows, int cols, int threads){
+
+    struct assignedRows AR;
+
+    //---------------------------------------------------------------
+    // Multi threading works in this program by dividing up the
+    // rows of the matrix, so there must be enough rows for each
+    // thread, or failing that enough columns.
+    //---------------------------------------------------------------
+    int workableRows = rows - 2;
+    int workableCols = cols - 2;
+    if (threads > workableRows && threads > workableCols){
+        printf("Matrix must have at least x+2 rows or columns to work with x threads.\n");
+        exit(0);
+    }
+    AR.byColumns = relaxSplitsByColumns(rows, cols, threads);
+
+
+    AR.assignedNumberOfRows = malloc(threads*sizeof(int));
+    AR.assignedStartRow = malloc(threads*sizeof(int));
+    AR.assignedNumberOfCols = malloc(threads*sizeof(int));
+    AR.assignedStartCol = malloc(threads*sizeof(int));
+
+    if (AR.byColumns){
+        spreadEvenly(1, workableCols, threads,
+                     AR.assignedStartCol, AR.assignedNumberOfCols);
+        for (int i=0; i<threads; i++){
+            AR.assignedStartRow[i] = 1;
+            AR.assignedNumberOfRows[i] = workableRows;
+        }
+    }
+    else{
+        spreadEvenly(1, workableRows, threads,
+                     AR.assignedStartRow, AR.assignedNumberOfRows);
+        for (int i=0; i<threads; i++){
+            AR.assignedStartCol[i] = 1;
+            AR.assignedNumberOfCols[i] = workableCols;
+        }
+    }
+
+    return AR;
+}
+
+
+void spreadByWeight(int first, int items, int threads, const long *before,
+                    int *start, int *number){
+
+    //---------------------------------------------------------------
+    // spreadEvenly by weight rather than count, before[k] being the
+    // weight of the first k items. Each thread's run ends at the item
+    // boundary nearest its share of the total, so runs stay contiguous
+    // and may be empty where one item outweighs a share.
+    //---------------------------------------------------------------
+    long total = before[items];
+    if (total == 0){
+        spreadEvenly(first, items, threads, start, number);
+        return;
+    }
+
+    int end = 0;
+    for (int i=0; i<threads; i++){
+        long target = total*(i+1) / threads;
+        int from = end;
+        while (end < items && before[end+1] <= target){
+            end++;
+        }
+        if (end < items && target - before[end] > before[end+1] - target){
+            end++;
+        }
+        if (i == threads-1){
+            end = items;
+        }
+        start[i] = first + from;
+        number[i] = end - from;
+    }
+}
+
+
+struct assignedRows getAssignedRowsMasked(const struct cellMask *mask,
+                                          int threads){
+
+    //---------------------------------------------------------------
+    // getAssignedRows with the bands cut so each thread has about as
+    // many active cells as the others, rather than rows or columns.
+    //---------------------------------------------------------------
+    int rows = mask->rows;
+    int cols = mask->cols;
+    struct assignedRows AR = getAssignedRows(rows, cols, threads);
+
+    if (AR.byColumns){
+        long *before = calloc(cols, sizeof(long));
+        for (int k=0; k<mask->rowStart[rows]; k++){
+            for (int j=mask->from[k]; j<=mask->to[k]; j++){
+                before[j]++;
+            }
+        }
+        long sum = 0;
+        for (int j=1; j<(cols-1); j++){
+            long weight = before[j];
+            before[j-1] = sum;
+            sum += weight;
+        }
+        before[cols-2] = sum;
+        spreadByWeight(1, cols-2, threads, before,
+                       AR.assignedStartCol, AR.assignedNumberOfCols);
+        free(before);
+    }
+    else{
+        long *before = malloc((rows-1)*sizeof(long));
+        for (int k=0; k<=(rows-2); k++){
+            before[k] = mask->activeBefore[k+1] - mask->activeBefore[1];
+        }
+        spreadByWeight(1, rows-2, threads, before,
+                       AR.assignedStartRow, AR.assignedNumberOfRows);
+        free(before);
+    }
+    return AR;
+}
+
+
+void freeAssignedRows(struct assignedRows *AR){
+    free(AR->assignedStartRow);
+    free(AR->assignedNumberOfRows);
+    free(AR->assignedStartCol);
+    free(AR->assignedNumberOfCols);
+    AR->assignedStartRow = NULL;
+    AR->assignedNumberOfRows = NULL;
+    AR->assignedStartCol = NULL;
+    AR->assignedNumberOfCols = NULL;
+}
+
+
+int allTrue(int **array, int size){
+    //---------------------------------------------------------------
+    // Checks all values in an array are 1;
+    //---------------------------------------------------------------
+    for (int i=0; i<size; i++){
+        if ((*array)[i] == 0){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+struct relaxOptions relax_default_options(){
+    struct relaxOptions options;
+    options.method = METHOD_JACOBI;
+    options.omega = 0.0;
+    options.convergence = CONVERGE_FLAGS;
+    options.checkEvery = 1;
+    options.temporalDepth = 0;
+    options.tileRows = 64;
+    options.tileCols = 512;
+    options.volumeTileRows = 16;
+    options.volumeTileCols = 512;
+    options.cycle = CYCLE_V;
+    options.smoothing = 2;
+    options.schedule = SCHEDULE_STATIC;
+    options.chunkRows = 8;
+    options.exchange = EXCHANGE_SHARED;
+    options.ghostDepth = 1;
+    options.numa = 0;
+    options.hugePages = 0;
+    options.cpuList = NULL;
+    options.checkpointPath = NULL;
+    options.checkpointEvery = 1000;
+    options.sweepsBefore = 0;
+    options.incremental = 0;
+    options.dataType = DTYPE_DOUBLE;
+    options.profile = 0;
+    options.tracePath = NULL;
+    options.stopRule = STOP_CHANGE;
+    options.maxSweeps = 0;
+    options.maxSeconds = 0.0;
+    options.stagnationSweeps = 0;
+    options.historyPath = NULL;
+    options.problem = NULL;
+    options.mask = NULL;
+    return options;
+}
+
+
+void relaxFailure(struct relaxContext *ctx, const char *format, ...){
+    //---------------------------------------------------------------
+    // Reports something the solve could not do, as printf would.
+    //---------------------------------------------------------------
+    va_list args;
+    va_start(args, format);
+    if (!ctx->keepFailures){
+        vprintf(format, args);
+        printf("\n");
+    }
+    else if (ctx->failure[0] == '\0'){
+        vsnprintf(ctx->failure, FAILURE_LENGTH, format, args);
+    }
+    va_end(args);
+}
+
+
+double relaxFloatTarget(int dataType, double precision, double largest, int quiet){
+    //---------------------------------------------------------------
+    // The precision float sweeps can aim for. Below a few roundings
+    // of the largest value the sweeps just jitter, so mixed hands
+    // over to doubles there, and float stops there with a warning.
+    //---------------------------------------------------------------
+    double floor = 16.0 * FLT_EPSILON * largest;
+    if (precision >= floor){
+        return precision;
+    }
+    if (dataType == DTYPE_FLOAT && !quiet){
+        printf("Floats can not settle below %e, stopping there.\n", floor);
+    }
+    return floor;
+}
+
+
+double relaxOmega(struct relaxOptions *options, int rows, int cols){
+    //---------------------------------------------------------------
+    // The over relaxation factor to use. Plain Gauss Seidel is 1, and
+    // SOR with no omega given uses the optimum for Laplace's equation
+    // on the grid, 2 / (1 + sqrt(1 - rho^2)) where rho, the Jacobi
+    // spectral radius, is the mean of cos(pi/(n-1)) over both sides.
+    // On a square grid this is 2 / (1 + sin(pi/(n-1))).
+    //---------------------------------------------------------------
+    if (options->method == METHOD_GS){
+        return 1.0;
+    }
+    if (options->omega > 0.0){
+        return options->omega;
+    }
+    double rho = (cos(M_PI / (rows-1)) + cos(M_PI / (cols-1))) / 2.0;
+    return 2.0 / (1.0 + sqrt(1.0 - rho*rho));
+}
+
+
+int relaxStopsEarly(struct relaxOptions *options){
+    //---------------------------------------------------------------
+    // Whether a solve may stop on anything but the largest change.
+    //---------------------------------------------------------------
+    return options->stopRule != STOP_CHANGE || options->maxSweeps > 0 ||
+           options->maxSeconds > 0.0 || options->stagnationSweeps > 0;
+}
+
+
+double relaxStopNorm(int stopRule, struct changeNorms *norms, long cells){
+    if (stopRule == STOP_RMS){
+        return sqrt(norms->sumSquares / cells);
+    }
+    if (stopRule == STOP_RELATIVE && norms->largest > 0.0){
+        return norms->max / norms->largest;
+    }
+    return norms->max;
+}
+
+
+int relaxStopReason(struct relaxOptions *options, struct stopState *state,
+                    int count, double norm, double precision, int outOfTime){
+    //---------------------------------------------------------------
+    // Decides whether checked sweep count is the last, returning why
+    // or -1 to carry on. Every thread sees the same norms and time
+    // verdict, so each can keep its own state and all stop together.
+    //---------------------------------------------------------------
+    if (sameNumberToPrecision(norm, 0.0, precision)){
+        return STOPPED_SETTLED;
+    }
+    if (options->maxSweeps > 0 && count >= options->maxSweeps){
+        return STOPPED_SWEEPS;
+    }
+    if (outOfTime){
+        return STOPPED_TIME;
+    }
+    if (options->stagnationSweeps > 0){
+        if (state->markCount == 0 || norm < STAGNATION_FACTOR*state->mark){
+            state->mark = norm;
+            state->markCount = count;
+        }
+        else if (count - state->markCount >= options->stagnationSweeps){
+            return STOPPED_STAGNATED;
+        }
+    }
+    return -1;
+}
+
+
+void atomicMaxResidual(unsigned long long *slot, double value){
+    //---------------------------------------------------------------
+    // Residuals are never negative, and non negative doubles sort
+    // the same way as their bit patterns, so an integer compare and
+    // swap is enough to take the max.
+    //---------------------------------------------------------------
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    unsigned long long current = __atomic_load_n(slot, __ATOMIC_RELAXED);
+    while (bits > current &&
+           !__atomic_compare_exchange_n(slot, &current, bits, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+
+double loadResidual(unsigned long long *slot){
+    unsigned long long bits = __atomic_load_n(slot, __ATOMIC_RELAXED);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+
+double nowSeconds(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1000000000.0;
+}
+
+
+double phaseStart(struct thread_args *p){
+    //---------------------------------------------------------------
+    // The time a phase starts at, when profiling, for phaseEnd
+    //---------------------------------------------------------------
+    if (!p->context->profiling){
+        return 0.0;
+    }
+    return nowSeconds();
+}
+
+
+void phaseEnd(struct thread_args *p, int phase, double start){
+    //---------------------------------------------------------------
+    // Adds the time since start to the thread's total for a phase,
+    // and keeps it as an event when tracing.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = p->context;
+    if (!ctx->profiling){
+        return;
+    }
+    double end = nowSeconds();
+    ctx->phases[p->threadNumber].seconds[phase] += end - start;
+
+    if (ctx->options.tracePath == NULL){
+        return;
+    }
+    if (p->eventCount == p->eventCapacity){
+        if (p->eventCapacity == TRACE_MAX_EVENTS){
+            return;
+        }
+        int capacity = p->eventCapacity == 0 ? 4096 : 2*p->eventCapacity;
+        if (capacity > TRACE_MAX_EVENTS){
+            capacity = TRACE_MAX_EVENTS;
+        }
+        struct traceEvent *events = realloc(p->events,
+                                            capacity*sizeof(struct traceEvent));
+        if (events == NULL){
+            return;
+        }
+        p->events = events;
+        p->eventCapacity = capacity;
+    }
+
+    struct traceEvent *event = &p->events[p->eventCount++];
+    event->start = start - ctx->profileOrigin;
+    event->end = end - ctx->profileOrigin;
+    event->phase = phase;
+}
+
+
+void recordResidual(struct relaxContext *ctx, int sweep, double residual){
+    //---------------------------------------------------------------
+    // Keeps the stopping norm of a sweep when profiling or keeping a
+    // history, called by thread 0 once every thread's change is in.
+    //---------------------------------------------------------------
+    if (!ctx->recording){
+        return;
+    }
+    if (ctx->residualCount == ctx->residualCapacity){
+        int capacity = ctx->residualCapacity == 0 ? 1024 :
+                       2*ctx->residualCapacity;
+        struct residualSample *history = realloc(ctx->residualHistory,
+                                                 capacity*sizeof(struct residualSample));
+        if (history == NULL){
+            return;
+        }
+        ctx->residualHistory = history;
+        ctx->residualCapacity = capacity;
+    }
+
+    struct residualSample *sample = &ctx->residualHistory[ctx->residualCount++];
+    sample->time = nowSeconds() - ctx->profileOrigin;
+    sample->sweep = ctx->residualSweepBase + sweep;
+    sample->residual = residual;
+}
+
+
+void relaxBudgetCheck(struct relaxContext *ctx, int count){
+    //---------------------------------------------------------------
+    // Thread 0 decides before the barrier whether the time budget
+    // is spent, so every thread reads the same verdict after it.
+    //---------------------------------------------------------------
+    ctx->budgetSpent[count % 3] = ctx->options.maxSeconds > 0.0 &&
+                                  nowSeconds() - ctx->solveStart >=
+                                  ctx->options.maxSeconds;
+}
+
+
+double relaxGlobalNormOf(struct thread_args *p, int count, double global,
+                         long cells){
+    //---------------------------------------------------------------
+    // The stopping norm of a checked sweep once every thread's share
+    // is in, added up in thread order so every thread gets the same.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = p->context;
+    if (ctx->options.stopRule == STOP_CHANGE){
+        return global;
+    }
+
+    struct changeNorms total = {global, 0.0, 0.0};
+    struct paddedNorms *slots = &ctx->norms[(count % 2)*p->totalThreads];
+    for (int i=0; i<p->totalThreads; i++){
+        total.sumSquares += slots[i].norms.sumSquares;
+        if (slots[i].norms.largest > total.largest){
+            total.largest = slots[i].norms.largest;
+        }
+    }
+    return relaxStopNorm(ctx->options.stopRule, &total, cells);
+}
+
+
+long relaxActiveCells(struct relaxOptions *options, int rows, int cols){
+    //---------------------------------------------------------------
+    // The cells a sweep relaxes, which the rms norm is taken over
+    //---------------------------------------------------------------
+    if (options->mask != NULL){
+        return options->mask->active;
+    }
+    return (long)(rows-2)*(cols-2);
+}
+
+
+double relaxGlobalNorm(struct thread_args *p, int count, double global){
+    return relaxGlobalNormOf(p, count, global,
+                             relaxActiveCells(&p->context->options, p->rows,
+                                              p->cols));
+}
+
+
+int takeChunk(struct chunkQueue *queue, int steal){
+    //---------------------------------------------------------------
+    // Takes the next chunk from the front of a queue, or the last
+    // chunk from the back when stealing. Returns -1 when empty.
+    //---------------------------------------------------------------
+    unsigned long long range = __atomic_load_n(&queue->range, __ATOMIC_RELAXED);
+    while (1){
+        unsigned long long head = range >> 32;
+        unsigned long long tail = range & 0xffffffffULL;
+        if (head >= tail){
+            return -1;
+        }
+
+        unsigned long long next = steal ? ((head << 32) | (tail - 1))
+                                        : (((head + 1) << 32) | tail);
+        if (__atomic_compare_exchange_n(&queue->range, &range, next, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+            return steal ? (int)(tail - 1) : (int)head;
+        }
+    }
+}
+
+
+void resetChunkQueue(struct relaxContext *ctx, int parity, int threadNumber,
+                     int rows){
+    int chunks = (rows - 2 + ctx->options.chunkRows - 1) / ctx->options.chunkRows;
+    int first, last;
+    splitRows(0, chunks-1, threadNumber, ctx->threads, &first, &last);
+
+    __atomic_store_n(&ctx->queues[parity*ctx->threads + threadNumber].range,
+                     ((unsigned long long)first << 32) |
+                     (unsigned long long)(last + 1),
+                     __ATOMIC_RELAXED);
+}
+
+
+double relaxStolenChunks(struct thread_args *p, double **read, double **write,
+                         int sweep){
+
+    //---------------------------------------------------------------
+    // Relaxes this thread's own chunks, then steals from the others
+    // until every queue is empty. Queues alternate between sweeps,
+    // and nobody looks at the other sweep's queues until after the
+    // barrier, so each thread refills its own for the next sweep.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = p->context;
+    int threads = p->totalThreads;
+    int threadNumber = p->threadNumber;
+    int chunkRows = ctx->options.chunkRows;
+    int parity = sweep % 2;
+    struct chunkQueue *queues = ctx->queues + parity*threads;
+    struct threadStats *stats = &ctx->stats[threadNumber];
+
+    double max = 0.0;
+    for (int v=0; v<threads; v++){
+        int victim = (threadNumber + v) % threads;
+        int steal = (victim != threadNumber);
+
+        int chunk;
+        while ((chunk = takeChunk(&queues[victim], steal)) >= 0){
+            int rowFrom = 1 + chunk*chunkRows;
+            int rowTo = rowFrom + chunkRows - 1;
+            if (rowTo > p->rows-2){
+                rowTo = p->rows-2;
+            }
+
+            double diff = relaxRowsFused(read[0], write[0], p->cols,
+                                         rowFrom, rowTo);
+            if (diff > max){
+                max = diff;
+            }
+            stats->chunks++;
+            stats->steals += steal;
+        }
+    }
+
+    resetChunkQueue(ctx, 1 - parity, threadNumber, p->rows);
+    return max;
+}
+
+
+void relaxCheckpointCopy(struct thread_args *p, double **matrix, int count){
+    //---------------------------------------------------------------
+    // Copies this thread's band of the matrix left by sweep count
+    // into the checkpoint buffer, if that sweep is due. The edges
+    // never change so they were copied when the solve started.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = p->context;
+    if (ctx->options.checkpointPath == NULL ||
+        ctx->checkpointDue[count % 2] != count){
+        return;
+    }
+
+    size_t bytes = (p->colTo - p->colFrom + 1)*sizeof(double);
+    for (int i=p->rowFrom; i<=p->rowTo; i++){
+        memcpy(ctx->checkpointBuffer[i] + p->colFrom, matrix[i] + p->colFrom,
+               bytes);
+    }
+}
+
+
+void relaxCheckpointSchedule(struct relaxContext *ctx, int count){
+    //---------------------------------------------------------------
+    // Called by thread 0 before the barrier that ends sweep count,
+    // marks the sweep due if it is a checkpoint sweep and the writer
+    // is free. A busy writer means this checkpoint is skipped rather
+    // than holding the threads up.
+    //---------------------------------------------------------------
+    if (ctx->options.checkpointPath == NULL){
+        return;
+    }
+
+    int due = (count % ctx->options.checkpointEvery == 0) &&
+              ctx->checkpointDue[(count-1) % 2] != count-1 &&
+              !__atomic_load_n(&ctx->checkpointBusy, __ATOMIC_ACQUIRE);
+    ctx->checkpointDue[count % 2] = due ? count : -1;
+}
+
+
+void relaxCheckpointPublish(struct relaxContext *ctx, int count){
+    //---------------------------------------------------------------
+    // Called by thread 0 after the barrier that ends sweep count. If
+    // the sweep before was due every thread has copied its band, so
+    // the buffer is handed to the writer.
+    //---------------------------------------------------------------
+    if (ctx->options.checkpointPath == NULL ||
+        ctx->checkpointDue[(count-1) % 2] != count-1){
+        return;
+    }
+
+    pthread_mutex_lock(&ctx->checkpointLock);
+    ctx->checkpointHeader.sweeps = ctx->options.sweepsBefore + count-1;
+    __atomic_store_n(&ctx->checkpointBusy, 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&ctx->checkpointChanged);
+    pthread_mutex_unlock(&ctx->checkpointLock);
+}
+
+
+void *relax_checkpoint_thread(void *payload){
+    //---------------------------------------------------------------
+    // Writes the checkpoint buffer out each time it is handed over,
+    // until the context shuts down.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = payload;
+
+    pthread_mutex_lock(&ctx->checkpointLock);
+    while (1){
+        while (!ctx->checkpointBusy && !ctx->shutdown){
+            pthread_cond_wait(&ctx->checkpointChanged, &ctx->checkpointLock);
+        }
+        if (!ctx->checkpointBusy){
+            break;
+        }
+        pthread_mutex_unlock(&ctx->checkpointLock);
+
+        int written = writeGridFile(ctx->options.checkpointPath,
+                                    &ctx->checkpointBuffer,
+                                    &ctx->checkpointHeader);
+
+        pthread_mutex_lock(&ctx->checkpointLock);
+        if (written != 0){
+            relaxFailure(ctx, "Could not write checkpoint '%s'.",
+                         ctx->options.checkpointPath);
+        }
+        ctx->checkpointsWritten++;
+        __atomic_store_n(&ctx->checkpointBusy, 0, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&ctx->checkpointChanged);
+    }
+    pthread_mutex_unlock(&ctx->checkpointLock);
+
+    return payload;
+}
+
+
+void relax_checkpoint_wait(struct relaxContext *ctx){
+    //---------------------------------------------------------------
+    // Waits for any checkpoint still being written to finish.
+    //---------------------------------------------------------------
+    if (!ctx->checkpointWriterStarted){
+        return;
+    }
+    pthread_mutex_lock(&ctx->checkpointLock);
+    while (ctx->checkpointBusy){
+        pthread_cond_wait(&ctx->checkpointChanged, &ctx->checkpointLock);
+    }
+    pthread_mutex_unlock(&ctx->checkpointLock);
+}
+
+
+void relax_rows_reduce(struct thread_args *p){
+
+    //---------------------------------------------------------------
+    // Every thread swaps its own copy of the matrix pointers, so
+    // no thread has to swap them for everyone behind a barrier.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = p->context;
+    double **current = *p->matrix;
+    double **previous = *p->lastMatrix;
+    int checkEvery = ctx->options.checkEvery;
+    int threadNumber = p->threadNumber;
+    int stealing = (ctx->options.schedule == SCHEDULE_STEAL);
+    int measuring = (ctx->options.stopRule != STOP_CHANGE);
+    struct stopState stop = {0.0, 0};
+
+    int count = 0;
+    while (1){
+
+        double phase = phaseStart(p);
+        relaxCheckpointCopy(p, current, count);
+
+        double local;
+        if (stealing){
+            double start = nowSeconds();
+            local = relaxStolenChunks(p, current, previous, count);
+            ctx->stats[threadNumber].busySeconds += nowSeconds() - start;
+        }
+        else{
+            local = relaxMaskedBlock(ctx->options.mask,
+                                     ctx->options.problem,
+                                     &current, &previous, p->cols,
+                                     p->rowFrom, p->rowTo,
+                                     p->colFrom, p->colTo);
+        }
+        swapMatrix(&current, &previous);
+        count++;
+        phaseEnd(p, PHASE_COMPUTE, phase);
+
+
+        //---------------------------------------------------------------
+        // Only every k'th sweep is checked. The slot for sweep n is
+        // read by everyone after the barrier at sweep n and is not
+        // written again until sweep n+3, so thread 0 can safely clear
+        // the slot for the next sweep while this one is in flight.
+        //---------------------------------------------------------------
+        phase = phaseStart(p);
+        int check = (count % checkEvery == 0);
+        if (check){
+            ctx->residuals[threadNumber].value = local;
+            atomicMaxResidual(&ctx->reduction[count % 3].maxBits, local);
+            if (measuring){
+                struct changeNorms norms = {local, 0.0, 0.0};
+                measureChangeRows(current, previous, p->rowFrom, p->rowTo,
+                                  p->colFrom, p->colTo, &norms);
+                ctx->norms[(count % 2)*p->totalThreads + threadNumber].norms =
+                    norms;
+            }
+        }
+        phaseEnd(p, PHASE_CHECK, phase);
+        if (threadNumber == 0){
+            phase = phaseStart(p);
+            __atomic_store_n(&ctx->reduction[(count+1) % 3].maxBits, 0,
+                             __ATOMIC_RELAXED);
+            if (check){
+                relaxBudgetCheck(ctx, count);
+            }
+            relaxCheckpointSchedule(ctx, count);
+            phaseEnd(p, PHASE_SERIAL, phase);
+        }
+
+        phase = phaseStart(p);
+        if (stealing){
+            double start = nowSeconds();
+            pthread_barrier_wait(p->barrier);
+            ctx->stats[threadNumber].waitSeconds += nowSeconds() - start;
+        }
+        else{
+            pthread_barrier_wait(p->barrier);
+        }
+        phaseEnd(p, PHASE_BARRIER, phase);
+        if (threadNumber == 0){
+            phase = phaseStart(p);
+            relaxCheckpointPublish(ctx, count);
+            phaseEnd(p, PHASE_SERIAL, phase);
+        }
+
+
+        if (check){
+            phase = phaseStart(p);
+            double global = loadResidual(&ctx->reduction[count % 3].maxBits);
+            double norm = relaxGlobalNorm(p, count, global);
+            int reason = relaxStopReason(&ctx->options, &stop, count, norm,
+                                         p->precision,
+                                         ctx->budgetSpent[count % 3]);
+            if (threadNumber == 0){
+                recordResidual(ctx, count, norm);
+                if (reason >= 0){
+                    ctx->result.stopReason = reason;
+                }
+            }
+            phaseEnd(p, PHASE_CHECK, phase);
+            if (reason >= 0){
+                break;
+            }
+        }
+    }
+
+
+    //---------------------------------------------------------------
+    // All threads leave on the same sweep and every write happened
+    // before the last barrier, so thread 0 can publish the pointers.
+    //---------------------------------------------------------------
+    if (threadNumber == 0){
+        *p->matrix = current;
+        *p->lastMatrix = previous;
+        ctx->result.sweeps = count;
+        ctx->result.residual = loadResidual(&ctx->reduction[count % 3].maxBits);
+    }
+}
+
+
+double tileSweepResidual(struct relaxContext *ctx, int parity, int sweep){
+    //---------------------------------------------------------------
+    // The largest change any thread saw on one sweep of a block.
+    //---------------------------------------------------------------
+    int threads = ctx->threads;
+    double global = 0.0;
+    for (int t=0; t<threads; t++){
+        double r = ctx->sweepResiduals[((size_t)parity*threads + t) *
+                                       ctx->sweepStride + sweep];
+        if (r > global){
+            global = r;
+        }
+    }
+    return global;
+}
+
+
+void relax_rows_tiled(struct thread_args *p){
+
+    struct relaxContext *ctx = p->context;
+    int threads = p->totalThreads;
+    int threadNumber = p->threadNumber;
+    int rows = p->rows;
+    int cols = p->cols;
+    int depth = ctx->options.temporalDepth;
+
+    int tileRows = ctx->options.tileRows;
+    int tileCols = ctx->options.tileCols;
+    int tilesDown = (rows - 2 + tileRows - 1) / tileRows;
+    int tilesAcross = (cols - 2 + tileCols - 1) / tileCols;
+    int tiles = tilesDown * tilesAcross;
+
+    double *a = ctx->tileBuffers[threadNumber];
+    double *b = a + ctx->tileBufferLength;
+
+    double **source = *p->matrix;
+    double **target = *p->lastMatrix;
+
+    int count = 0;
+    int block = 0;
+    int blockDepth = depth;
+    double residual = 0.0;
+
+    while (1){
+
+        //---------------------------------------------------------------
+        // Take tiles until there are none left in this block. Blocks
+        // alternate between two counters, thread 0 clears the one for
+        // the next block as nobody can still be taking from it.
+        //---------------------------------------------------------------
+        double phase = phaseStart(p);
+        int parity = block % 2;
+        double *mine = ctx->sweepResiduals +
+                       ((size_t)parity*threads + threadNumber)*ctx->sweepStride;
+        for (int s=0; s<blockDepth; s++){
+            mine[s] = 0.0;
+        }
+
+        unsigned long long tile;
+        while ((tile = __atomic_fetch_add(&ctx->tileCounter[parity].maxBits, 1,
+                                          __ATOMIC_RELAXED)) < tiles){
+            int rowFrom = 1 + (tile / tilesAcross) * tileRows;
+            int colFrom = 1 + (tile % tilesAcross) * tileCols;
+            int rowTo = rowFrom + tileRows - 1;
+            int colTo = colFrom + tileCols - 1;
+
+            relaxTile(source, target, rows, cols,
+                      rowFrom, rowTo < rows-2 ? rowTo : rows-2,
+                      colFrom, colTo < cols-2 ? colTo : cols-2,
+                      blockDepth, a, b, mine);
+        }
+        phaseEnd(p, PHASE_COMPUTE, phase);
+        if (threadNumber == 0){
+            __atomic_store_n(&ctx->tileCounter[1-parity].maxBits, 0,
+                             __ATOMIC_RELAXED);
+        }
+
+        phase = phaseStart(p);
+        pthread_barrier_wait(p->barrier);
+        phaseEnd(p, PHASE_BARRIER, phase);
+
+
+        //---------------------------------------------------------------
+        // Find the first sweep of the block on which every cell
+        // settled, exactly where plain Jacobi would have stopped.
+        //---------------------------------------------------------------
+        phase = phaseStart(p);
+        int settled = -1;
+        for (int s=0; s<blockDepth && settled < 0; s++){
+            double global = tileSweepResidual(ctx, parity, s);
+            if (sameNumberToPrecision(global, 0.0, p->precision)){
+                settled = s;
+                residual = global;
+            }
+        }
+        block++;
+
+
+        //---------------------------------------------------------------
+        // A block that is run again is only recorded the second time,
+        // so every sweep is in the history once.
+        //---------------------------------------------------------------
+        if (threadNumber == 0 && ctx->recording &&
+            (settled < 0 || settled == blockDepth-1)){
+            for (int s=0; s<blockDepth; s++){
+                recordResidual(ctx, count+s+1,
+                               tileSweepResidual(ctx, parity, s));
+            }
+        }
+        phaseEnd(p, PHASE_CHECK, phase);
+
+        if (settled < 0){
+            count += blockDepth;
+            swapMatrix(&source, &target);
+        }
+        else if (settled == blockDepth-1){
+            count += blockDepth;
+            swapMatrix(&source, &target);
+            break;
+        }
+        else{
+            //---------------------------------------------------------------
+            // The matrix settled part way through the block, the source
+            // is untouched so the block is run again stopping there.
+            //---------------------------------------------------------------
+            blockDepth = settled + 1;
+        }
+    }
+
+    if (threadNumber == 0){
+        *p->matrix = source;
+        *p->lastMatrix = target;
+        ctx->result.sweeps = count;
+        ctx->result.residual = residual;
+    }
+}
+
+
+void relax_rows_redblack(struct thread_args *p){
+
+    //---------------------------------------------------------------
+    // Each thread relaxes the red cells of its band, waits for every
+    // red cell to be done, then does the black cells. Convergence is
+    // reduced the same way as the REDUCE mode, riding on the barrier
+    // after the black cells.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = p->context;
+    double **matrix = *p->matrix;
+    double omega = relaxOmega(&ctx->options, p->rows, p->cols);
+    int checkEvery = ctx->options.checkEvery;
+    int threadNumber = p->threadNumber;
+    int measuring = (ctx->options.stopRule != STOP_CHANGE);
+    struct stopState stop = {0.0, 0};
+
+    int count = 0;
+    while (1){
+
+        //---------------------------------------------------------------
+        // Sweeps that will be checked against a norm other than the
+        // largest change measure it while relaxing, as the cells
+        // change in place and the old values are gone afterwards.
+        //---------------------------------------------------------------
+        double phase = phaseStart(p);
+        relaxCheckpointCopy(p, matrix, count);
+        int check = ((count+1) % checkEvery == 0);
+        struct changeNorms norms = {0.0, 0.0, 0.0};
+
+        double red;
+        if (measuring && check){
+            red = relaxRowsRedBlackNorms(matrix, p->rowFrom, p->rowTo,
+                                         p->colFrom, p->colTo, 0, omega,
+                                         &norms);
+        }
+        else{
+            red = relaxRowsRedBlack(matrix, p->rowFrom, p->rowTo,
+                                    p->colFrom, p->colTo, 0, omega);
+        }
+        phaseEnd(p, PHASE_COMPUTE, phase);
+
+        phase = phaseStart(p);
+        pthread_barrier_wait(p->barrier);
+        phaseEnd(p, PHASE_BARRIER, phase);
+
+        phase = phaseStart(p);
+        double black;
+        if (measuring && check){
+            black = relaxRowsRedBlackNorms(matrix, p->rowFrom, p->rowTo,
+                                           p->colFrom, p->colTo, 1, omega,
+                                           &norms);
+        }
+        else{
+            black = relaxRowsRedBlack(matrix, p->rowFrom, p->rowTo,
+                                      p->colFrom, p->colTo, 1, omega);
+        }
+        double local = red > black ? red : black;
+        count++;
+        phaseEnd(p, PHASE_COMPUTE, phase);
+
+        phase = phaseStart(p);
+        if (check){
+            ctx->residuals[threadNumber].value = local;
+            atomicMaxResidual(&ctx->reduction[count % 3].maxBits, local);
+            if (measuring){
+                ctx->norms[(count % 2)*p->totalThreads + threadNumber].norms =
+                    norms;
+            }
+        }
+        phaseEnd(p, PHASE_CHECK, phase);
+        if (threadNumber == 0){
+            phase = phaseStart(p);
+            __atomic_store_n(&ctx->reduction[(count+1) % 3].maxBits, 0,
+                             __ATOMIC_RELAXED);
+            if (check){
+                relaxBudgetCheck(ctx, count);
+            }
+            relaxCheckpointSchedule(ctx, count);
+            phaseEnd(p, PHASE_SERIAL, phase);
+        }
+
+        phase = phaseStart(p);
+        pthread_barrier_wait(p->barrier);
+        phaseEnd(p, PHASE_BARRIER, phase);
+        if (threadNumber == 0){
+            phase = phaseStart(p);
+            relaxCheckpointPublish(ctx, count);
+            phaseEnd(p, PHASE_SERIAL, phase);
+        }
+
+
+        if (check){
+            phase = phaseStart(p);
+            double global = loadResidual(&ctx->reduction[count % 3].maxBits);
+            double norm = relaxGlobalNorm(p, count, global);
+            int reason = relaxStopReason(&ctx->options, &stop, count, norm,
+                                         p->precision,
+                                         ctx->budgetSpent[count % 3]);
+            if (threadNumber == 0){
+                recordResidual(ctx, count, norm);
+                if (reason >= 0){
+                    ctx->result.stopReason = reason;
+                }
+            }
+            phaseEnd(p, PHASE_CHECK, phase);
+            if (reason >= 0){
+                break;
+            }
+        }
+    }
+
+    if (threadNumber == 0){
+        ctx->result.sweeps = count;
+        ctx->result.residual = loadResidual(&ctx->reduction[count % 3].maxBits);
+    }
+}
+
+
+void multigridSmooth(struct thread_args *p, struct multigridLevel *L,
+                     int sweeps){
+
+    int rowFrom, rowTo;
+    splitRows(1, L->rows-2, p->threadNumber, p->totalThreads,
+              &rowFrom, &rowTo);
+
+    for (int k=0; k<sweeps; k++){
+        smoothRowsRedBlack(L->u, L->b, L->cols, rowFrom, rowTo, 0);
+        pthread_barrier_wait(p->barrier);
+        smoothRowsRedBlack(L->u, L->b, L->cols, rowFrom, rowTo, 1);
+        pthread_barrier_wait(p->barrier);
+    }
+}
+
+
+void multigridCycle(struct thread_args *p, int level, int cycle){
+
+    //---------------------------------------------------------------
+    // Every thread runs the same recursion, working on its share of
+    // the rows of each level with a barrier after each stage. The
+    // coarsest level is small enough to just smooth until solved.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = p->context;
+    struct multigridLevel *L = &ctx->levels[level];
+    int threadNumber = p->threadNumber;
+    int threads = p->totalThreads;
+
+    if (level == ctx->levelCount-1){
+        multigridSmooth(p, L, 4*MULTIGRID_COARSEST*MULTIGRID_COARSEST);
+        return;
+    }
+
+    multigridSmooth(p, L, ctx->options.smoothing);
+
+
+    //---------------------------------------------------------------
+    // Restrict the residual to the next level down as its right
+    // hand side, and start its correction from zero.
+    //---------------------------------------------------------------
+    int rowFrom, rowTo;
+    splitRows(1, L->rows-2, threadNumber, threads, &rowFrom, &rowTo);
+    residualRows(L->u, L->b, L->r, L->cols, rowFrom, rowTo);
+    pthread_barrier_wait(p->barrier);
+
+    struct multigridLevel *C = &ctx->levels[level+1];
+    int coarseFrom, coarseTo;
+    splitRows(0, C->rows-1, threadNumber, threads, &coarseFrom, &coarseTo);
+    zeroRows(C->u, C->cols, coarseFrom, coarseTo);
+    splitRows(1, C->rows-2, threadNumber, threads, &coarseFrom, &coarseTo);
+    restrictRows(L->r, C->b, C->cols, coarseFrom, coarseTo);
+    pthread_barrier_wait(p->barrier);
+
+
+    //---------------------------------------------------------------
+    // An F cycle follows its coarse F cycle with a V cycle, a V
+    // cycle just recurses once.
+    //---------------------------------------------------------------
+    multigridCycle(p, level+1, cycle);
+    if (cycle == CYCLE_F){
+        multigridCycle(p, level+1, CYCLE_V);
+    }
+
+    prolongRows(C->u, L->u, L->cols, rowFrom, rowTo);
+    pthread_barrier_wait(p->barrier);
+
+    multigridSmooth(p, L, ctx->options.smoothing);
+}
+
+
+void relax_rows_multigrid(struct thread_args *p){
+
+    struct relaxContext *ctx = p->context;
+    struct multigridLevel *fine = &ctx->levels[0];
+    int threadNumber = p->threadNumber;
+
+    int rowFrom, rowTo;
+    splitRows(1, p->rows-2, threadNumber, p->totalThreads, &rowFrom, &rowTo);
+
+    int count = 0;
+    double global;
+    while (1){
+
+        double phase = phaseStart(p);
+        multigridCycle(p, 0, ctx->options.cycle);
+        count++;
+        phaseEnd(p, PHASE_COMPUTE, phase);
+
+
+        //---------------------------------------------------------------
+        // A Jacobi sweep would change each cell by a quarter of its
+        // residual, so stop on the same test as the other methods.
+        //---------------------------------------------------------------
+        phase = phaseStart(p);
+        double local = residualRows(fine->u, NULL, fine->r, p->cols,
+                                    rowFrom, rowTo) / 4.0;
+        ctx->residuals[threadNumber].value = local;
+        phaseEnd(p, PHASE_CHECK, phase);
+
+        phase = phaseStart(p);
+        pthread_barrier_wait(p->barrier);
+        phaseEnd(p, PHASE_BARRIER, phase);
+
+        phase = phaseStart(p);
+        global = 0.0;
+        for (int i=0; i<p->totalThreads; i++){
+            if (ctx->residuals[i].value > global){
+                global = ctx->residuals[i].value;
+            }
+        }
+        if (threadNumber == 0){
+            recordResidual(ctx, count * 2 * ctx->options.smoothing, global);
+        }
+        phaseEnd(p, PHASE_CHECK, phase);
+        if (sameNumberToPrecision(global, 0.0, p->precision)){
+            break;
+        }
+    }
+
+    if (threadNumber == 0){
+        ctx->result.sweeps = count * 2 * ctx->options.smoothing;
+        ctx->result.residual = global;
+        ctx->result.cycles = count;
+    }
+}
+
+
+void markActiveRow(struct activeRows *active, int row, double diff){
+    if (diff != 0.0){
+        if (row < active->first){
+            active->first = row;
+        }
+        if (row > active->last){
+            active->last = row;
+        }
+    }
+}
+
+
+void relax_rows_window(struct thread_args *p){
+
+    //---------------------------------------------------------------
+    // Relaxes only a window of rows, starting at the rows next to the
+    // changed boundary. Each sweep the window grows to take in the
+    // rows a change can reach from any row that moved at all, one row
+    // for Jacobi and two for red black, whose black cells see the red
+    // cells of the same sweep. It never shrinks. Rows outside it are
+    // then exactly those a full sweep would leave as they are, so the
+    // sweeps, the stopping test and the answer are those of a full
+    // solve. Rows outside the window are the same in both Jacobi
+    // buffers, as neither has been written there.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = p->context;
+    int jacobi = (ctx->options.method == METHOD_JACOBI);
+    double omega = relaxOmega(&ctx->options, p->rows, p->cols);
+    double **current = *p->matrix;
+    double **previous = jacobi ? *p->lastMatrix : NULL;
+    int threadNumber = p->threadNumber;
+    int threads = p->totalThreads;
+
+    int reach = jacobi ? 1 : 2;
+    int windowFrom = ctx->windowFrom - (reach-1);
+    int windowTo = ctx->windowTo + (reach-1);
+    if (windowFrom < 1){
+        windowFrom = 1;
+    }
+    if (windowTo > p->rows-2){
+        windowTo = p->rows-2;
+    }
+
+    int count = 0;
+    double residual = 0.0;
+    while (1){
+
+        double phase = phaseStart(p);
+        struct activeRows *active = &ctx->active[(count % 2)*threads +
+                                                 threadNumber];
+        active->first = p->rows;
+        active->last = -1;
+
+        int rowFrom, rowTo;
+        splitRows(windowFrom, windowTo, threadNumber, threads,
+                  &rowFrom, &rowTo);
+
+        double local = 0.0;
+        if (jacobi){
+            for (int i=rowFrom; i<=rowTo; i++){
+                double diff = relaxRowsFused(current[0], previous[0], p->cols,
+                                             i, i);
+                markActiveRow(active, i, diff);
+                if (diff > local){
+                    local = diff;
+                }
+            }
+            swapMatrix(&current, &previous);
+        }
+        else{
+            for (int i=rowFrom; i<=rowTo; i++){
+                double diff = relaxRowsRedBlack(current, i, i, 1, p->cols-2,
+                                                0, omega);
+                markActiveRow(active, i, diff);
+                if (diff > local){
+                    local = diff;
+                }
+            }
+            phaseEnd(p, PHASE_COMPUTE, phase);
+            phase = phaseStart(p);
+            pthread_barrier_wait(p->barrier);
+            phaseEnd(p, PHASE_BARRIER, phase);
+            phase = phaseStart(p);
+            for (int i=rowFrom; i<=rowTo; i++){
+                double diff = relaxRowsRedBlack(current, i, i, 1, p->cols-2,
+                                                1, omega);
+                markActiveRow(active, i, diff);
+                if (diff > local){
+                    local = diff;
+                }
+            }
+        }
+        active->residual = local;
+        count++;
+        phaseEnd(p, PHASE_COMPUTE, phase);
+
+        phase = phaseStart(p);
+        pthread_barrier_wait(p->barrier);
+        phaseEnd(p, PHASE_BARRIER, phase);
+
+
+        //---------------------------------------------------------------
+        // Every thread works out the same next window, or that the
+        // solve is done. The slots for this sweep are not written
+        // again until after the next sweep's barrier, so no second
+        // barrier is needed.
+        //---------------------------------------------------------------
+        phase = phaseStart(p);
+        int first = p->rows;
+        int last = -1;
+        residual = 0.0;
+        for (int t=0; t<threads; t++){
+            struct activeRows *other = &ctx->active[((count-1) % 2)*threads + t];
+            if (other->first < first){
+                first = other->first;
+            }
+            if (other->last > last){
+                last = other->last;
+            }
+            if (other->residual > residual){
+                residual = other->residual;
+            }
+        }
+        if (threadNumber == 0){
+            recordResidual(ctx, count, residual);
+        }
+        phaseEnd(p, PHASE_CHECK, phase);
+
+        if (sameNumberToPrecision(residual, 0.0, p->precision)){
+            break;
+        }
+        if (last >= 0 && first-reach < windowFrom){
+            windowFrom = first-reach < 1 ? 1 : first-reach;
+        }
+        if (last >= 0 && last+reach > windowTo){
+            windowTo = last+reach > p->rows-2 ? p->rows-2 : last+reach;
+        }
+    }
+
+    if (threadNumber == 0){
+        *p->matrix = current;
+        if (jacobi){
+            *p->lastMatrix = previous;
+        }
+        ctx->result.sweeps = count;
+        ctx->result.residual = residual;
+        ctx->result.cycles = 0;
+    }
+}
+
+
+void relax_rows_float(struct thread_args *p){
+
+    //---------------------------------------------------------------
+    // The REDUCE loop over the float matrices, the residuals are
+    // widened to doubles to share the reduction slots.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = p->context;
+    float **current = *p->floatMatrix;
+    float **previous = *p->floatLastMatrix;
+    int checkEvery = ctx->options.checkEvery;
+    int threadNumber = p->threadNumber;
+
+    int count = 0;
+    double best = INFINITY;
+    int bestCount = 0;
+    while (1){
+
+        double phase = phaseStart(p);
+        double local = relaxMatrixBlockFusedFloat(&current, &previous,
+                                                  p->rowFrom, p->rowTo,
+                                                  p->colFrom, p->colTo);
+        {
+            float **temp = current;
+            current = previous;
+            previous = temp;
+        }
+        count++;
+        phaseEnd(p, PHASE_COMPUTE, phase);
+
+        phase = phaseStart(p);
+        int check = (count % checkEvery == 0);
+        if (check){
+            atomicMaxResidual(&ctx->reduction[count % 3].maxBits, local);
+        }
+        if (threadNumber == 0){
+            __atomic_store_n(&ctx->reduction[(count+1) % 3].maxBits, 0,
+                             __ATOMIC_RELAXED);
+        }
+        phaseEnd(p, PHASE_CHECK, phase);
+
+        phase = phaseStart(p);
+        pthread_barrier_wait(p->barrier);
+        phaseEnd(p, PHASE_BARRIER, phase);
+
+        if (check){
+            phase = phaseStart(p);
+            double global = loadResidual(&ctx->reduction[count % 3].maxBits);
+            if (threadNumber == 0){
+                recordResidual(ctx, count, global);
+            }
+            phaseEnd(p, PHASE_CHECK, phase);
+            if (sameFloatToPrecision(global, 0.0f, p->precision)){
+                break;
+            }
+            //---------------------------------------------------------------
+            // Every thread sees the same global change, so they all
+            // give up on the same sweep.
+            //---------------------------------------------------------------
+            if (global < best){
+                best = global;
+                bestCount = count;
+            }
+            else if (count - bestCount >= FLOAT_STALL_SWEEPS){
+                break;
+            }
+        }
+    }
+
+    if (threadNumber == 0){
+        *p->floatMatrix = current;
+        *p->floatLastMatrix = previous;
+        ctx->result.sweeps = count;
+        ctx->result.residual = loadResidual(&ctx->reduction[count % 3].maxBits);
+        ctx->result.cycles = 0;
+    }
+}
+
+
+void asyncCheckDone(struct relaxContext *ctx){
+    //---------------------------------------------------------------
+    // Thread 0's termination test. It marks every thread's count of
+    // sweeps and of sweeps that moved a cell by more than the
+    // precision, and the solve is done once every thread has swept
+    // its whole band again since the mark without a moving sweep.
+    // Others' sweep in flight at the mark may have started before
+    // it, so they need two more, thread 0 just the one. Any moving
+    // sweep makes it mark again. Moved counts are read before sweep
+    // counts when marking and after when testing, so a sweep caught
+    // half way is always taken as moving.
+    //---------------------------------------------------------------
+    int threads = ctx->threads;
+    int *markSweeps = ctx->asyncMark;
+    int *markMoved = ctx->asyncMark + threads;
+
+    if (ctx->asyncMarked){
+        int confirmed = 1;
+        for (int i=0; i<threads && ctx->asyncMarked; i++){
+            int sweeps = __atomic_load_n(&ctx->progress[i].sweeps,
+                                         __ATOMIC_ACQUIRE);
+            int moved = __atomic_load_n(&ctx->progress[i].moved,
+                                        __ATOMIC_RELAXED);
+            if (moved != markMoved[i]){
+                ctx->asyncMarked = 0;
+            }
+            if (sweeps < markSweeps[i] + (i == 0 ? 1 : 2)){
+                confirmed = 0;
+            }
+        }
+        if (ctx->asyncMarked){
+            if (confirmed){
+                __atomic_store_n(&ctx->asyncDone, 1, __ATOMIC_RELEASE);
+            }
+            return;
+        }
+    }
+
+    for (int i=0; i<threads; i++){
+        markMoved[i] = __atomic_load_n(&ctx->progress[i].moved,
+                                       __ATOMIC_ACQUIRE);
+        markSweeps[i] = __atomic_load_n(&ctx->progress[i].sweeps,
+                                        __ATOMIC_ACQUIRE);
+    }
+    ctx->asyncMarked = 1;
+}
+
+
+void relax_rows_async(struct thread_args *p){
+
+    //---------------------------------------------------------------
+    // Chaotic relaxation. Each thread sweeps its band of the one
+    // matrix in place, row by row into a spare row that is then
+    // copied back, so each row is relaxed from the newest rows
+    // either side of it, its neighbours' included, whatever sweep
+    // they are on. Threads never wait for each other until the end,
+    // only thread 0 spends any time on termination.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = p->context;
+    int threadNumber = p->threadNumber;
+    double **matrix = *p->matrix;
+    gridReuse(&p->work[0], 1, p->cols);
+    double *row = p->work[0].data;
+    size_t bytes = (p->colTo - p->colFrom + 1)*sizeof(double);
+    struct asyncProgress *mine = &ctx->progress[threadNumber];
+
+    while (!__atomic_load_n(&ctx->asyncDone, __ATOMIC_ACQUIRE)){
+
+        double phase = phaseStart(p);
+        double local = 0.0;
+        for (int i=p->rowFrom; i<=p->rowTo; i++){
+            double diff = relaxColumnsFused(matrix[i-1], matrix[i],
+                                            matrix[i+1], row,
+                                            p->colFrom, p->colTo);
+            memcpy(matrix[i] + p->colFrom, row + p->colFrom, bytes);
+            if (diff > local){
+                local = diff;
+            }
+        }
+        phaseEnd(p, PHASE_COMPUTE, phase);
+
+        phase = phaseStart(p);
+        mine->change = local;
+        if (!sameNumberToPrecision(local, 0.0, p->precision)){
+            __atomic_store_n(&mine->moved, mine->moved + 1, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&mine->sweeps, mine->sweeps + 1, __ATOMIC_RELEASE);
+        if (threadNumber == 0){
+            asyncCheckDone(ctx);
+        }
+        phaseEnd(p, PHASE_CHECK, phase);
+    }
+
+    double phase = phaseStart(p);
+    pthread_barrier_wait(p->barrier);
+    phaseEnd(p, PHASE_BARRIER, phase);
+
+    if (threadNumber == 0){
+        ctx->result.sweeps = 0;
+        ctx->result.residual = 0.0;
+        ctx->result.cycles = 0;
+        for (int i=0; i<p->totalThreads; i++){
+            if (ctx->progress[i].sweeps > ctx->result.sweeps){
+                ctx->result.sweeps = ctx->progress[i].sweeps;
+            }
+            if (ctx->progress[i].change > ctx->result.residual){
+                ctx->result.residual = ctx->progress[i].change;
+            }
+        }
+    }
+}
+
+
+double **haloSubgrid(int rows, int cols){
+    //---------------------------------------------------------------
+    // A subgrid on cache line aligned memory rounded up to whole
+    // lines, so no line of it is shared with another thread's data.
+    // Free it with freeMatrix.
+    //---------------------------------------------------------------
+    double **matrix = malloc(rows*sizeof(double*));
+    double *buf;
+    size_t bytes = ((size_t)rows*cols*sizeof(double) + CACHE_LINE-1) /
+                   CACHE_LINE * CACHE_LINE;
+    if (matrix == NULL ||
+        posix_memalign((void **)&buf, CACHE_LINE, bytes) != 0){
+        printf("Subgrid is null so exiting");
+        exit(0);
+    }
+    for (int i=0; i<rows; i++){
+        matrix[i] = buf + (size_t)cols*i;
+    }
+    return matrix;
+}
+
+
+void haloPrepare(struct thread_args *p, int rows, int cols, int depth){
+    //---------------------------------------------------------------
+    // Makes the thread's subgrids and mailboxes for a band of rows
+    // including its ghost rows, only when the size changes. Each
+    // thread makes its own so the pages are placed near it.
+    //---------------------------------------------------------------
+    if (p->halo[0] == NULL || p->haloRows != rows || p->haloCols != cols){
+        if (p->halo[0] != NULL){
+            freeMatrix(&p->halo[0]);
+            freeMatrix(&p->halo[1]);
+        }
+        p->halo[0] = haloSubgrid(rows, cols);
+        p->halo[1] = haloSubgrid(rows, cols);
+        p->haloRows = rows;
+        p->haloCols = cols;
+    }
+
+    size_t cells = (size_t)depth*cols;
+    if (p->mailCells != cells){
+        free(p->mailTop[0]);
+        size_t bytes = (4*cells*sizeof(double) + CACHE_LINE-1) /
+                       CACHE_LINE * CACHE_LINE;
+        if (posix_memalign((void **)&p->mailTop[0], CACHE_LINE, bytes) != 0){
+            printf("Mailbox is null so exiting");
+            exit(0);
+        }
+        p->mailTop[1] = p->mailTop[0] + cells;
+        p->mailBottom[0] = p->mailTop[0] + 2*cells;
+        p->mailBottom[1] = p->mailTop[0] + 3*cells;
+        p->mailCells = cells;
+    }
+}
+
+
+void haloWait(int *counter, int target){
+    //---------------------------------------------------------------
+    // Waits for another thread to move a counter up to target,
+    // yielding so threads sharing a cpu still make progress.
+    //---------------------------------------------------------------
+    while (__atomic_load_n(counter, __ATOMIC_ACQUIRE) < target){
+        sched_yield();
+    }
+}
+
+
+void haloExchange(struct thread_args *p, double **subgrid, int top,
+                  int depth, int exchange){
+
+    //---------------------------------------------------------------
+    // Puts this thread's edge rows out for its neighbours and copies
+    // theirs into its ghost rows. A mailbox is only refilled once
+    // the neighbour has copied what was put in it two exchanges ago,
+    // so the only waits are on the two neighbours.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = p->context;
+    int threadNumber = p->threadNumber;
+    int above = threadNumber > 0;
+    int below = threadNumber < p->totalThreads-1;
+    int parity = exchange % 2;
+    size_t bytes = (size_t)depth*p->cols*sizeof(double);
+
+    if (above){
+        haloWait(&ctx->haloTakenAbove[threadNumber].value, exchange-2);
+        memcpy(p->mailTop[parity], subgrid[p->rowFrom - top], bytes);
+    }
+    if (below){
+        haloWait(&ctx->haloTakenBelow[threadNumber].value, exchange-2);
+        memcpy(p->mailBottom[parity], subgrid[p->rowTo-depth+1 - top], bytes);
+    }
+    __atomic_store_n(&ctx->haloPublished[threadNumber].value, exchange,
+                     __ATOMIC_RELEASE);
+
+    if (above){
+        struct thread_args *neighbour = &ctx->args[threadNumber-1];
+        haloWait(&ctx->haloPublished[threadNumber-1].value, exchange);
+        memcpy(subgrid[0], neighbour->mailBottom[parity], bytes);
+        __atomic_store_n(&ctx->haloTakenBelow[threadNumber-1].value, exchange,
+                         __ATOMIC_RELEASE);
+    }
+    if (below){
+        struct thread_args *neighbour = &ctx->args[threadNumber+1];
+        haloWait(&ctx->haloPublished[threadNumber+1].value, exchange);
+        memcpy(subgrid[p->rowTo+1 - top], neighbour->mailTop[parity], bytes);
+        __atomic_store_n(&ctx->haloTakenAbove[threadNumber+1].value, exchange,
+                         __ATOMIC_RELEASE);
+    }
+}
+
+
+void relax_rows_halo(struct thread_args *p){
+
+    //---------------------------------------------------------------
+    // Each thread sweeps a private copy of its band with depth ghost
+    // rows either side, and between exchanges relaxes the ghost rows
+    // too, one fewer each side every sweep, so its own rows are
+    // exact after depth sweeps. The change is checked on the last
+    // sweep of each block, every thread adds its own to a reduction
+    // slot and reads the total a sweep later, by which time the
+    // others have usually added theirs, so no thread waits on more
+    // than its neighbours. The sweep before is still in the second
+    // subgrid, which is the answer once it is found to be settled.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = p->context;
+    int threadNumber = p->threadNumber;
+    int threads = p->totalThreads;
+    int rows = p->rows;
+    int cols = p->cols;
+
+    int depth = ctx->options.ghostDepth;
+    if (depth > (rows-2) / threads){
+        depth = (rows-2) / threads;
+    }
+
+    int top = p->rowFrom - depth < 0 ? 0 : p->rowFrom - depth;
+    int bottom = p->rowTo + depth > rows-1 ? rows-1 : p->rowTo + depth;
+    int localRows = bottom - top + 1;
+
+    double phase = phaseStart(p);
+    haloPrepare(p, localRows, cols, depth);
+    double **current = p->halo[0];
+    double **next = p->halo[1];
+    for (int i=top; i<=bottom; i++){
+        memcpy(current[i-top], (*p->matrix)[i], cols*sizeof(double));
+        memcpy(next[i-top], (*p->matrix)[i], cols*sizeof(double));
+    }
+    phaseEnd(p, PHASE_SERIAL, phase);
+
+    int block = 0;
+    int settled = 0;
+    double global = 0.0;
+    while (!settled){
+
+        if (block > 0){
+            phase = phaseStart(p);
+            haloExchange(p, current, top, depth, block);
+            phaseEnd(p, PHASE_BARRIER, phase);
+        }
+
+        for (int s=1; s<=depth; s++){
+            //---------------------------------------------------------------
+            // Rows next to the matrix's own edge never change, so the
+            // range only shrinks on sides that have ghost rows.
+            //---------------------------------------------------------------
+            phase = phaseStart(p);
+            int from = top == 0 ? 1 : s;
+            int to = bottom == rows-1 ? localRows-2 : localRows-1-s;
+            double local = relaxMatrixRowsFused(&current, &next, cols,
+                                                from, to);
+            double **temp = current;
+            current = next;
+            next = temp;
+            phaseEnd(p, PHASE_COMPUTE, phase);
+
+            //---------------------------------------------------------------
+            // The slot for block n is read during block n+1. Once every
+            // thread has added block n+1's change they are all past
+            // that, so thread 0 clears it then, in block n+2, before
+            // adding its own change, which anyone adding block n+3's
+            // must wait for.
+            //---------------------------------------------------------------
+            phase = phaseStart(p);
+            if (s == 1 && block > 0){
+                int slot = (block-1) % 3;
+                haloWait(&ctx->haloArrived[slot].value, threads);
+                global = loadResidual(&ctx->reduction[slot].maxBits);
+                settled = sameNumberToPrecision(global, 0.0, p->precision);
+                if (threadNumber == 0){
+                    recordResidual(ctx, block*depth, global);
+                    __atomic_store_n(&ctx->reduction[(block+1) % 3].maxBits,
+                                     0, __ATOMIC_RELAXED);
+                    __atomic_store_n(&ctx->haloArrived[(block+1) % 3].value,
+                                     0, __ATOMIC_RELAXED);
+                }
+            }
+            if (s == depth && !settled){
+                atomicMaxResidual(&ctx->reduction[block % 3].maxBits, local);
+                __atomic_add_fetch(&ctx->haloArrived[block % 3].value, 1,
+                                   __ATOMIC_RELEASE);
+            }
+            phaseEnd(p, PHASE_CHECK, phase);
+            if (settled){
+                break;
+            }
+        }
+        block++;
+    }
+
+
+    //---------------------------------------------------------------
+    // Every thread stops on the same block, and each band goes back
+    // into the caller's matrix from the sweep found to be settled.
+    //---------------------------------------------------------------
+    phase = phaseStart(p);
+    for (int i=p->rowFrom; i<=p->rowTo; i++){
+        memcpy((*p->matrix)[i], next[i-top], cols*sizeof(double));
+    }
+    phaseEnd(p, PHASE_SERIAL, phase);
+
+    if (threadNumber == 0){
+        ctx->result.sweeps = (block-1)*depth;
+        ctx->result.residual = global;
+        ctx->result.cycles = 0;
+    }
+}
+
+
+void relax_rows(struct thread_args *p){
+
+    if (p->context->windowed){
+        relax_rows_window(p);
+        return;
+    }
+
+    if (p->context->options.method == METHOD_MULTIGRID){
+        relax_rows_multigrid(p);
+        return;
+    }
+    if (p->context->options.method != METHOD_JACOBI){
+        relax_rows_redblack(p);
+        return;
+    }
+    if (p->context->options.temporalDepth > 0){
+        relax_rows_tiled(p);
+        return;
+    }
+    if (p->context->options.convergence == CONVERGE_ASYNC){
+        relax_rows_async(p);
+        return;
+    }
+    if (p->context->options.exchange == EXCHANGE_HALO &&
+        !p->context->AR.byColumns){
+        relax_rows_halo(p);
+        return;
+    }
+    if (p->context->options.convergence == CONVERGE_REDUCE ||
+        p->context->options.schedule == SCHEDULE_STEAL ||
+        p->context->options.checkpointPath != NULL ||
+        relaxStopsEarly(&p->context->options)){
+        relax_rows_reduce(p);
+        return;
+    }
+
+
+    double ***matrix = p->matrix;
+    double ***lastMatrix = p->lastMatrix;
+    int **rowsComplete = p->rowsComplete;
+    int threadNumber = p->threadNumber;
+
+    struct relaxContext *ctx = p->context;
+    int count = 0;
+    while (1){
+
+        double phase;
+        if (threadNumber == 0){
+            //printf("Matrix after %d step/s\n", count);
+            //printMatrix(matrix, p->rows, p->cols);
+
+            phase = phaseStart(p);
+            swapMatrix(matrix, lastMatrix);
+            phaseEnd(p, PHASE_SERIAL, phase);
+        }
+
+
+        phase = phaseStart(p);
+        pthread_barrier_wait(p->barrier);
+        phaseEnd(p, PHASE_BARRIER, phase);
+
+        //printf("Thread %d relaxing its rows\n", threadNumber);
+        phase = phaseStart(p);
+        double local = relaxMaskedBlock(ctx->options.mask,
+                                        ctx->options.problem,
+                                        lastMatrix, matrix, p->cols,
+                                        p->rowFrom, p->rowTo,
+                                        p->colFrom, p->colTo);
+        count++;
+        phaseEnd(p, PHASE_COMPUTE, phase);
+
+
+        //---------------------------------------------------------------
+        // The flag is worked out again every sweep, rows that settled
+        // early can be pushed back out by slower neighbours, so it is
+        // only done once every thread's rows settle on the same sweep.
+        //---------------------------------------------------------------
+        phase = phaseStart(p);
+        ctx->residuals[threadNumber].value = local;
+        (*rowsComplete)[threadNumber] = sameNumberToPrecision(local, 0.0,
+                                                              p->precision);
+        phaseEnd(p, PHASE_CHECK, phase);
+
+        phase = phaseStart(p);
+        pthread_barrier_wait(p->barrier);
+        phaseEnd(p, PHASE_BARRIER, phase);
+
+
+        phase = phaseStart(p);
+        int settled = allTrue(rowsComplete, p->totalThreads);
+        if (threadNumber == 0 && ctx->recording){
+            double global = 0.0;
+            for (int i=0; i<p->totalThreads; i++){
+                if (ctx->residuals[i].value > global){
+                    global = ctx->residuals[i].value;
+                }
+            }
+            recordResidual(ctx, count, global);
+        }
+        phaseEnd(p, PHASE_CHECK, phase);
+
+        if (settled){
+            //printf("Thread %d found all to be correct now\n", threadNumber);
+            phase = phaseStart(p);
+            pthread_barrier_wait(p->barrier);
+            phaseEnd(p, PHASE_BARRIER, phase);
+            break;
+        }
+    }
+
+    pthread_barrier_wait(p->barrier);
+
+    if (threadNumber == 0){
+        ctx->result.sweeps = count;
+        ctx->result.residual = 0.0;
+        ctx->result.cycles = 0;
+        for (int i=0; i<p->totalThreads; i++){
+            if (ctx->residuals[i].value > ctx->result.residual){
+                ctx->result.residual = ctx->residuals[i].value;
+            }
+        }
+        //printf("Final matrix\n");
+        //printMatrix(matrix, p->rows, p->cols);
+    }
+}
+
+
+void *relax_worker_thread(void *payload){
+    //---------------------------------------------------------------
+    // Body of each pooled worker. Waits for the calling thread to
+    // publish a job, such as 'relax_rows' on its assigned rows, then
+    // waits again until told to shut down.
+    //---------------------------------------------------------------
+    struct thread_args *p = payload;
+    struct relaxContext *ctx = p->context;
+
+    while (1){
+        pthread_barrier_wait(&ctx->jobBarrier);
+        if (ctx->shutdown){
+            break;
+        }
+
+        ctx->job(p);
+
+        pthread_barrier_wait(&ctx->jobBarrier);
+    }
+
+    return payload;
+}
+
+
+struct relaxContext *relax_context_create(int threads){
+
+    if (threads < 1){
+        printf("You cannot run on less than 1 thread.\n");
+        exit(0);
+    }
+
+    struct relaxContext *ctx = malloc(sizeof(struct relaxContext));
+    if (ctx == NULL){
+        printf("Context is null so exiting");
+        exit(0);
+    }
+
+    ctx->threads = threads;
+    ctx->shutdown = 0;
+    ctx->options = relax_default_options();
+
+    if (relaxRow == NULL){
+        selectRelaxKernel(KERNEL_AUTO);
+    }
+    ctx->result.sweeps = 0;
+    ctx->result.residual = 0.0;
+    ctx->result.stopReason = STOPPED_SETTLED;
+    ctx->lastMatrix = NULL;
+    ctx->volume = NULL;
+    ctx->lastVolume = volumeEmpty();
+    ctx->lastMatrixMapped = 0;
+    ctx->lastMatrixHugePages = 0;
+    ctx->assignedMask = NULL;
+    ctx->pinnedCpuList = NULL;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                               &ctx->startAffinity) != 0){
+        CPU_ZERO(&ctx->startAffinity);
+        for (int cpu=0; cpu<CPU_SETSIZE; cpu++){
+            CPU_SET(cpu, &ctx->startAffinity);
+        }
+    }
+    ctx->rows = 0;
+    ctx->cols = 0;
+    ctx->AR.assignedStartRow = NULL;
+    ctx->AR.assignedNumberOfRows = NULL;
+    ctx->AR.assignedStartCol = NULL;
+    ctx->AR.assignedNumberOfCols = NULL;
+    ctx->job = &relax_rows;
+    ctx->levels = NULL;
+    ctx->levelCount = 0;
+    ctx->levelRows = 0;
+    ctx->levelCols = 0;
+    ctx->checkpointBuffer = NULL;
+    ctx->checkpointRows = 0;
+    ctx->checkpointCols = 0;
+    ctx->checkpointBusy = 0;
+    ctx->checkpointWriterStarted = 0;
+    ctx->checkpointsWritten = 0;
+    initGridHeader(&ctx->checkpointHeader, 0, 0);
+    pthread_mutex_init(&ctx->checkpointLock, NULL);
+    pthread_cond_init(&ctx->checkpointChanged, NULL);
+    ctx->windowed = 0;
+    ctx->floatMatrix = NULL;
+    ctx->floatLastMatrix = NULL;
+    ctx->floatRows = 0;
+    ctx->floatCols = 0;
+    ctx->batch = NULL;
+    ctx->batchOrder = NULL;
+    ctx->batchWhole = 0;
+    ctx->quiet = 0;
+    ctx->keepFailures = 0;
+    ctx->failure[0] = '\0';
+    ctx->profiling = 0;
+    ctx->recording = 0;
+    ctx->profileOrigin = 0.0;
+    ctx->residualHistory = NULL;
+    ctx->residualCount = 0;
+    ctx->residualCapacity = 0;
+    ctx->residualSweepBase = 0;
+    ctx->tileBuffers = calloc(threads, sizeof(double*));
+    ctx->tileBufferLength = 0;
+    ctx->sweepResiduals = NULL;
+    ctx->sweepStride = 0;
+    ctx->rowsComplete = malloc(threads*sizeof(int));
+    ctx->asyncMark = malloc(2*threads*sizeof(int));
+    ctx->args = malloc(threads*sizeof(struct thread_args));
+    ctx->workers = malloc(threads*sizeof(pthread_t));
+    if (posix_memalign((void **)&ctx->residuals, CACHE_LINE,
+                       threads*sizeof(struct paddedResidual)) != 0 ||
+        posix_memalign((void **)&ctx->queues, CACHE_LINE,
+                       2*threads*sizeof(struct chunkQueue)) != 0 ||
+        posix_memalign((void **)&ctx->stats, CACHE_LINE,
+                       threads*sizeof(struct threadStats)) != 0 ||
+        posix_memalign((void **)&ctx->active, CACHE_LINE,
+                       2*threads*sizeof(struct activeRows)) != 0 ||
+        posix_memalign((void **)&ctx->phases, CACHE_LINE,
+                       threads*sizeof(struct phaseStats)) != 0 ||
+        posix_memalign((void **)&ctx->norms, CACHE_LINE,
+                       2*threads*sizeof(struct paddedNorms)) != 0 ||
+        posix_memalign((void **)&ctx->haloPublished, CACHE_LINE,
+                       threads*sizeof(struct paddedCounter)) != 0 ||
+        posix_memalign((void **)&ctx->haloTakenAbove, CACHE_LINE,
+                       threads*sizeof(struct paddedCounter)) != 0 ||
+        posix_memalign((void **)&ctx->haloTakenBelow, CACHE_LINE,
+                       threads*sizeof(struct paddedCounter)) != 0 ||
+        posix_memalign((void **)&ctx->progress, CACHE_LINE,
+                       threads*sizeof(struct asyncProgress)) != 0){
+        printf("Residuals are null so exiting");
+        exit(0);
+    }
+
+    pthread_barrier_init(&ctx->barrier, NULL, threads);
+    pthread_barrier_init(&ctx->jobBarrier, NULL, threads);
+
+    for (int i=0; i<threads; i++){
+        ctx->args[i].context = ctx;
+        ctx->args[i].barrier = &ctx->barrier;
+        ctx->args[i].threadNumber = i;
+        ctx->args[i].totalThreads = threads;
+        ctx->args[i].work[0] = gridEmpty();
+        ctx->args[i].work[1] = gridEmpty();
+        ctx->args[i].events = NULL;
+        ctx->args[i].eventCount = 0;
+        ctx->args[i].eventCapacity = 0;
+        ctx->args[i].halo[0] = NULL;
+        ctx->args[i].halo[1] = NULL;
+        ctx->args[i].haloRows = 0;
+        ctx->args[i].haloCols = 0;
+        ctx->args[i].mailTop[0] = NULL;
+        ctx->args[i].mailCells = 0;
+    }
+
+
+    //---------------------------------------------------------------
+    // Start the pooled workers, the last slot of args belongs to the
+    // calling thread.
+    //---------------------------------------------------------------
+    for (int i=0; i<(threads-1); i++){
+        pthread_create(&ctx->workers[i], NULL,
+                       &relax_worker_thread, &ctx->args[i]);
+    }
+
+    return ctx;
+}
+
+
+void relax_context_run(struct relaxContext *ctx,
+                       void (*job)(struct thread_args *p)){
+    //---------------------------------------------------------------
+    // Release the pooled workers on a job and run the last thread's
+    // share on *this* thread, then wait for every worker to finish.
+    //---------------------------------------------------------------
+    ctx->job = job;
+    pthread_barrier_wait(&ctx->jobBarrier);
+    job(&ctx->args[ctx->threads-1]);
+    pthread_barrier_wait(&ctx->jobBarrier);
+}
+
+
+int parseCpuList(const char *cpuList, int *cpus, int maxCpus){
+    //---------------------------------------------------------------
+    // Reads a list such as "0-3,8,10-11" into cpus, returning how
+    // many were read, or 0 if the list is not valid.
+    //---------------------------------------------------------------
+    int count = 0;
+    const char *c = cpuList;
+    while (*c != '\0'){
+        char *end;
+        long first = strtol(c, &end, 10);
+        long last = first;
+        if (end == c || first < 0){
+            return 0;
+        }
+        if (*end == '-'){
+            c = end + 1;
+            last = strtol(c, &end, 10);
+            if (end == c || last < first){
+                return 0;
+            }
+        }
+        for (long cpu=first; cpu<=last && count<maxCpus; cpu++){
+            cpus[count++] = (int)cpu;
+        }
+
+        if (*end == ','){
+            end++;
+        }
+        else if (*end != '\0'){
+            return 0;
+        }
+        c = end;
+    }
+    return count;
+}
+
+
+void relax_context_unpin(struct relaxContext *ctx){
+
+    //---------------------------------------------------------------
+    // Lets every thread run on any cpu it could when the context was
+    // made.
+    //---------------------------------------------------------------
+    for (int i=0; i<ctx->threads; i++){
+        pthread_t thread = (i == ctx->threads-1) ? pthread_self()
+                                                 : ctx->workers[i];
+        if (pthread_setaffinity_np(thread, sizeof(cpu_set_t),
+                                   &ctx->startAffinity) != 0){
+            relaxFailure(ctx, "Could not unpin thread %d.", i);
+        }
+    }
+    free(ctx->pinnedCpuList);
+    ctx->pinnedCpuList = NULL;
+}
+
+
+void relax_context_pin(struct relaxContext *ctx, const char *cpuList){
+
+    //---------------------------------------------------------------
+    // Pins each pooled worker, and the calling thread which runs the
+    // last thread's share, to a cpu from the list in turn. The list
+    // is copied, as the options only borrow it, and only kept once
+    // every thread is pinned. Should any thread fail, every thread
+    // is unpinned again, so the next solve with the list tries
+    // afresh.
+    //---------------------------------------------------------------
+    int cpus[CPU_SETSIZE];
+    int count = parseCpuList(cpuList, cpus, CPU_SETSIZE);
+    if (count == 0){
+        relaxFailure(ctx, "Could not read cpu list '%s'.", cpuList);
+        return;
+    }
+
+    int pinned = 1;
+    for (int i=0; i<ctx->threads; i++){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[i % count], &set);
+
+        pthread_t thread = (i == ctx->threads-1) ? pthread_self()
+                                                 : ctx->workers[i];
+        if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0){
+            relaxFailure(ctx, "Could not pin thread %d to cpu %d.", i,
+                         cpus[i % count]);
+            pinned = 0;
+        }
+    }
+
+    char *copy = pinned ? strdup(cpuList) : NULL;
+    if (pinned && copy == NULL){
+        relaxFailure(ctx, "Out of memory copying cpu list '%s'.", cpuList);
+    }
+    if (copy == NULL){
+        relax_context_unpin(ctx);
+        return;
+    }
+    free(ctx->pinnedCpuList);
+    ctx->pinnedCpuList = copy;
+}
+
+
+void relax_context_place_threads(struct relaxContext *ctx){
+
+    //---------------------------------------------------------------
+    // Pins the threads when the options name a cpu list other than
+    // the one they are on, and unpins them when the options name
+    // none.
+    //---------------------------------------------------------------
+    const char *cpuList = ctx->options.cpuList;
+    if (cpuList != NULL &&
+        (ctx->pinnedCpuList == NULL ||
+         strcmp(cpuList, ctx->pinnedCpuList) != 0)){
+        relax_context_pin(ctx, cpuList);
+    }
+    else if (cpuList == NULL && ctx->pinnedCpuList != NULL){
+        relax_context_unpin(ctx);
+    }
+}
+
+
+//-------------------------------------------------------------------
+// What relax_set_option returns for a name it does not know, so the
+// caller can try its own options before giving up.
+//-------------------------------------------------------------------
+const char RELAX_UNKNOWN_OPTION[] = "Unknown option.";
+
+
+const char *relax_set_option(struct relaxOptions *options,
+                             const char *name, const char *value){
+
+    //---------------------------------------------------------------
+    // Sets one solver option from its name and value as written on
+    // the command line. Returns NULL once set, RELAX_UNKNOWN_OPTION
+    // when the name is not a solver option, or why the value can not
+    // be used. Path and cpu list values are kept, not copied, so must
+    // outlive the options.
+    //---------------------------------------------------------------
+    if (strcmp(name, "method") == 0){
+        if (strcmp(value, "jacobi") == 0){
+            options->method = METHOD_JACOBI;
+        }
+        else if (strcmp(value, "gs") == 0){
+            options->method = METHOD_GS;
+        }
+        else if (strcmp(value, "sor") == 0){
+            options->method = METHOD_SOR;
+        }
+        else if (strcmp(value, "multigrid") == 0){
+            options->method = METHOD_MULTIGRID;
+        }
+        else{
+            return "Method must be 'jacobi', 'gs', 'sor' or 'multigrid'.";
+        }
+    }
+    else if (strcmp(name, "omega") == 0){
+        sscanf(value, "%lf", &options->omega);
+        if (options->omega <= 0.0 || options->omega >= 2.0){
+            return "Omega must be between 0 and 2.";
+        }
+    }
+    else if (strcmp(name, "cycle") == 0){
+        if (strcmp(value, "v") == 0){
+            options->cycle = CYCLE_V;
+        }
+        else if (strcmp(value, "f") == 0){
+            options->cycle = CYCLE_F;
+        }
+        else{
+            return "Cycle must be 'v' or 'f'.";
+        }
+    }
+    else if (strcmp(name, "smooth") == 0){
+        options->smoothing = atoi(value);
+        if (options->smoothing < 1){
+            return "Multigrid needs at least 1 smoothing sweep.";
+        }
+    }
+    else if (strcmp(name, "schedule") == 0){
+        if (strcmp(value, "static") == 0){
+            options->schedule = SCHEDULE_STATIC;
+        }
+        else if (strcmp(value, "steal") == 0){
+            options->schedule = SCHEDULE_STEAL;
+        }
+        else{
+            return "Schedule must be 'static' or 'steal'.";
+        }
+    }
+    else if (strcmp(name, "chunk") == 0){
+        options->chunkRows = atoi(value);
+        if (options->chunkRows < 1){
+            return "A chunk must have at least 1 row.";
+        }
+    }
+    else if (strcmp(name, "numa") == 0){
+        options->numa = atoi(value);
+    }
+    else if (strcmp(name, "hugepages") == 0){
+        options->hugePages = atoi(value);
+    }
+    else if (strcmp(name, "cpus") == 0){
+        int cpus[CPU_SETSIZE];
+        if (parseCpuList(value, cpus, CPU_SETSIZE) == 0){
+            return "Cpus must be a list such as 0-3,8,10-11.";
+        }
+        options->cpuList = value;
+    }
+    else if (strcmp(name, "convergence") == 0){
+        if (strcmp(value, "flags") == 0){
+            options->convergence = CONVERGE_FLAGS;
+        }
+        else if (strcmp(value, "reduce") == 0){
+            options->convergence = CONVERGE_REDUCE;
+        }
+        else if (strcmp(value, "async") == 0){
+            options->convergence = CONVERGE_ASYNC;
+        }
+        else{
+            return "Convergence must be 'flags', 'reduce' or 'async'.";
+        }
+    }
+    else if (strcmp(name, "kernel") == 0){
+        if (strcmp(value, "auto") == 0){
+            selectRelaxKernel(KERNEL_AUTO);
+        }
+        else if (strcmp(value, "scalar") == 0){
+            selectRelaxKernel(KERNEL_SCALAR);
+        }
+        else if (strcmp(value, "avx2") == 0){
+            selectRelaxKernel(KERNEL_AVX2);
+        }
+        else if (strcmp(value, "avx512") == 0){
+            selectRelaxKernel(KERNEL_AVX512);
+        }
+        else{
+            return "Kernel must be 'auto', 'scalar', 'avx2' or 'avx512'.";
+        }
+    }
+    else if (strcmp(name, "depth") == 0){
+        options->temporalDepth = atoi(value);
+        if (options->temporalDepth < 0){
+            return "Temporal blocking depth can not be negative.";
+        }
+    }
+    else if (strcmp(name, "tile") == 0){
+        if (sscanf(value, "%dx%d", &options->tileRows, &options->tileCols) != 2 ||
+            options->tileRows < 1 || options->tileCols < 1){
+            return "Tile must be given as rowsxcols, eg 64x512.";
+        }
+    }
+    else if (strcmp(name, "volumetile") == 0){
+        if (sscanf(value, "%dx%d", &options->volumeTileRows,
+                   &options->volumeTileCols) != 2 ||
+            options->volumeTileRows < 1 || options->volumeTileCols < 1){
+            return "Volume tile must be given as rowsxcols, eg 16x512.";
+        }
+    }
+    else if (strcmp(name, "dtype") == 0){
+        if (strcmp(value, "double") == 0){
+            options->dataType = DTYPE_DOUBLE;
+        }
+        else if (strcmp(value, "float") == 0){
+            options->dataType = DTYPE_FLOAT;
+        }
+        else if (strcmp(value, "mixed") == 0){
+            options->dataType = DTYPE_MIXED;
+        }
+        else{
+            return "Dtype must be 'double', 'float' or 'mixed'.";
+        }
+    }
+    else if (strcmp(name, "incremental") == 0){
+        options->incremental = atoi(value);
+    }
+    else if (strcmp(name, "profile") == 0){
+        options->profile = atoi(value);
+    }
+    else if (strcmp(name, "trace") == 0){
+        options->tracePath = value;
+    }
+    else if (strcmp(name, "exchange") == 0){
+        if (strcmp(value, "shared") == 0){
+            options->exchange = EXCHANGE_SHARED;
+        }
+        else if (strcmp(value, "halo") == 0){
+            options->exchange = EXCHANGE_HALO;
+        }
+        else{
+            return "Exchange must be 'shared' or 'halo'.";
+        }
+    }
+    else if (strcmp(name, "ghost") == 0){
+        options->ghostDepth = atoi(value);
+        if (options->ghostDepth < 1){
+            return "Halos need at least 1 ghost row.";
+        }
+    }
+    else if (strcmp(name, "stop") == 0){
+        if (strcmp(value, "change") == 0){
+            options->stopRule = STOP_CHANGE;
+        }
+        else if (strcmp(value, "rms") == 0){
+            options->stopRule = STOP_RMS;
+        }
+        else if (strcmp(value, "relative") == 0){
+            options->stopRule = STOP_RELATIVE;
+        }
+        else{
+            return "Stop must be 'change', 'rms' or 'relative'.";
+        }
+    }
+    else if (strcmp(name, "maxsweeps") == 0){
+        options->maxSweeps = atoi(value);
+        if (options->maxSweeps < 1){
+            return "A solve needs at least 1 sweep.";
+        }
+    }
+    else if (strcmp(name, "maxtime") == 0){
+        sscanf(value, "%lf", &options->maxSeconds);
+        if (options->maxSeconds <= 0.0){
+            return "The time allowed must be above 0 seconds.";
+        }
+    }
+    else if (strcmp(name, "stagnation") == 0){
+        options->stagnationSweeps = atoi(value);
+        if (options->stagnationSweeps < 1){
+            return "Stagnation needs at least 1 sweep.";
+        }
+    }
+    else if (strcmp(name, "history") == 0){
+        options->historyPath = value;
+    }
+    else if (strcmp(name, "checkpoint") == 0){
+        options->checkpointPath = value;
+    }
+    else if (strcmp(name, "checkpointevery") == 0){
+        options->checkpointEvery = atoi(value);
+        if (options->checkpointEvery < 1){
+            return "Checkpoints can not be written less than every sweep.";
+        }
+    }
+    else if (strcmp(name, "check") == 0){
+        options->checkEvery = atoi(value);
+        if (options->checkEvery < 1){
+            return "Convergence can not be checked less than every sweep.";
+        }
+    }
+    else{
+        return RELAX_UNKNOWN_OPTION;
+    }
+    return NULL;
+}
+
+
+const char *relax_options_problem(struct relaxOptions *options){
+
+    //---------------------------------------------------------------
+    // Returns why the options ask for things that do not work
+    // together, or NULL when they do.
+    //---------------------------------------------------------------
+    if (options->dataType != DTYPE_DOUBLE &&
+        (options->method != METHOD_JACOBI || options->temporalDepth > 0 ||
+         options->schedule == SCHEDULE_STEAL ||
+         options->checkpointPath != NULL || options->incremental)){
+        return "Float and mixed sweeps only work with plain jacobi.";
+    }
+    if (options->checkpointPath != NULL &&
+        (options->temporalDepth > 0 || options->method == METHOD_MULTIGRID)){
+        return "Checkpoints only work with jacobi, gs and sor, without temporal blocking.";
+    }
+    if (options->temporalDepth > 0 && options->method != METHOD_JACOBI){
+        return "Temporal blocking only works with the jacobi method.";
+    }
+    if (relaxStopsEarly(options) &&
+        (options->method == METHOD_MULTIGRID || options->temporalDepth > 0 ||
+         options->dataType != DTYPE_DOUBLE || options->incremental)){
+        return "Stopping rules and limits only work with jacobi, gs and sor sweeps in double, without temporal blocking or incremental re-solves.";
+    }
+    if (options->exchange == EXCHANGE_HALO &&
+        (options->method != METHOD_JACOBI || options->temporalDepth > 0 ||
+         options->schedule == SCHEDULE_STEAL ||
+         options->checkpointPath != NULL ||
+         options->dataType != DTYPE_DOUBLE || relaxStopsEarly(options))){
+        return "Halo exchange only works with plain jacobi and the default stopping rule.";
+    }
+    if (options->convergence == CONVERGE_ASYNC &&
+        (options->method != METHOD_JACOBI || options->temporalDepth > 0 ||
+         options->schedule == SCHEDULE_STEAL ||
+         options->exchange == EXCHANGE_HALO ||
+         options->checkpointPath != NULL ||
+         options->dataType != DTYPE_DOUBLE || relaxStopsEarly(options))){
+        return "Asynchronous relaxation only works with plain jacobi and the default stopping rule.";
+    }
+    if (options->stopRule != STOP_CHANGE &&
+        options->schedule == SCHEDULE_STEAL){
+        return "The rms and relative stopping rules do not work with stealing.";
+    }
+    if (options->problem != NULL &&
+        options->problem->kind != PROBLEM_LAPLACE &&
+        (options->method != METHOD_JACOBI || options->temporalDepth > 0 ||
+         options->schedule == SCHEDULE_STEAL ||
+         options->exchange == EXCHANGE_HALO ||
+         options->convergence == CONVERGE_ASYNC ||
+         options->dataType != DTYPE_DOUBLE || options->incremental)){
+        return "Sources and coefficients only work with plain jacobi in double.";
+    }
+    if (options->mask != NULL &&
+        (options->method != METHOD_JACOBI || options->temporalDepth > 0 ||
+         options->schedule == SCHEDULE_STEAL ||
+         options->exchange == EXCHANGE_HALO ||
+         options->convergence == CONVERGE_ASYNC ||
+         options->dataType != DTYPE_DOUBLE || options->incremental)){
+        return "Masks only work with plain jacobi in double.";
+    }
+    return NULL;
+}
+
+
+const char *relax_volume_options_problem(struct relaxOptions *options){
+
+    //---------------------------------------------------------------
+    // Returns why the options can not be used on a volume, or NULL
+    //---------------------------------------------------------------
+    if (options->method != METHOD_JACOBI ||
+        options->dataType != DTYPE_DOUBLE || options->temporalDepth > 0 ||
+        options->schedule == SCHEDULE_STEAL ||
+        options->exchange == EXCHANGE_HALO ||
+        options->convergence == CONVERGE_ASYNC ||
+        options->checkpointPath != NULL || options->incremental){
+        return "Volumes only work with plain jacobi in double.";
+    }
+    return NULL;
+}
+
+
+void relax_context_free_scratch(struct relaxContext *ctx){
+    //---------------------------------------------------------------
+    // Frees the scratch matrix, however it was made
+    //---------------------------------------------------------------
+    if (ctx->lastMatrix == NULL){
+        return;
+    }
+    if (ctx->lastMatrixMapped){
+        freeMatrixMapped(&ctx->lastMatrix, ctx->rows);
+    }
+    else{
+        freeMatrix(&ctx->lastMatrix);
+    }
+}
+
+
+void relax_context_assign_rows(struct relaxContext *ctx, int rows, int cols){
+
+    //---------------------------------------------------------------
+    // Only rework the row assignment when the size or mask changes,
+    // and hand each thread its rows.
+    //---------------------------------------------------------------
+    if (ctx->rows != rows || ctx->cols != cols ||
+        ctx->assignedMask != ctx->options.mask){
+        relax_context_free_scratch(ctx);
+        if (ctx->rows != 0){
+            freeAssignedRows(&ctx->AR);
+        }
+        if (ctx->options.mask != NULL){
+            ctx->AR = getAssignedRowsMasked(ctx->options.mask, ctx->threads);
+        }
+        else{
+            ctx->AR = getAssignedRows(rows, cols, ctx->threads);
+        }
+        ctx->assignedMask = ctx->options.mask;
+        ctx->rows = rows;
+        ctx->cols = cols;
+    }
+
+    for (int i=0; i<ctx->threads; i++){
+        struct thread_args *p = &ctx->args[i];
+
+        p->lastMatrix = &ctx->lastMatrix;
+        p->rowsComplete = &ctx->rowsComplete;
+        p->rows = rows;
+        p->cols = cols;
+        p->rowFrom = ctx->AR.assignedStartRow[i];
+        p->rowTo = ctx->AR.assignedStartRow[i] +
+                   ctx->AR.assignedNumberOfRows[i] - 1;
+        p->colFrom = ctx->AR.assignedStartCol[i];
+        p->colTo = ctx->AR.assignedStartCol[i] +
+                   ctx->AR.assignedNumberOfCols[i] - 1;
+    }
+
+    relax_context_place_threads(ctx);
+}
+
+
+void firstTouchRows(struct thread_args *p, double **from, double **to){
+    //---------------------------------------------------------------
+    // Copies (or zeroes when from is NULL) this thread's rows, and
+    // the boundary row next to them at either end of the matrix, so
+    // those pages land on this thread's NUMA node. Column bands share
+    // every row, so then the rows are just split evenly.
+    //---------------------------------------------------------------
+    int rowFrom = p->rowFrom;
+    int rowTo = p->rowTo;
+    if (p->context->AR.byColumns){
+        splitRows(1, p->rows-2, p->threadNumber, p->totalThreads,
+                  &rowFrom, &rowTo);
+    }
+    if (p->threadNumber == 0){
+        rowFrom = 0;
+    }
+    if (p->threadNumber == p->totalThreads-1){
+        rowTo = p->rows-1;
+    }
+
+    for (int i=rowFrom; i<=rowTo; i++){
+        if (from == NULL){
+            memset(to[i], 0, p->cols*sizeof(double));
+        }
+        else{
+            memcpy(to[i], from[i], p->cols*sizeof(double));
+        }
+    }
+}
+
+
+void relax_rows_copy(struct thread_args *p){
+    firstTouchRows(p, *p->matrix, *p->lastMatrix);
+}
+
+
+void relax_rows_zero(struct thread_args *p){
+    firstTouchRows(p, NULL, *p->matrix);
+}
+
+
+double **relax_context_create_matrix(struct relaxContext *ctx,
+                                     int rows, int cols){
+
+    //---------------------------------------------------------------
+    // Creates a matrix whose rows are first touched by the threads
+    // that will relax them, for filling in before a solve. Free it
+    // with relax_context_free_matrix.
+    //---------------------------------------------------------------
+    relax_context_assign_rows(ctx, rows, cols);
+
+    double **matrix = createMatrixMapped(rows, cols, ctx->options.hugePages);
+    for (int i=0; i<ctx->threads; i++){
+        ctx->args[i].matrix = &matrix;
+    }
+    relax_context_run(ctx, &relax_rows_zero);
+
+    return matrix;
+}
+
+
+void relax_context_free_matrix(double ***matrix, int rows){
+    freeMatrixMapped(matrix, rows);
+}
+
+
+void matrixTaskRows(struct thread_args *p, int *rowFrom, int *rowTo){
+    //---------------------------------------------------------------
+    // This thread's share of the task's rows. Tasks split whole rows
+    // evenly rather than taking the solve's bands, which may be
+    // columns, so they work for any size on any number of threads.
+    //---------------------------------------------------------------
+    struct matrixTask *task = &p->context->task;
+    splitRows(0, task->rows-1, p->threadNumber, p->totalThreads,
+              rowFrom, rowTo);
+}
+
+
+void relax_rows_fill(struct thread_args *p){
+    struct matrixTask *task = &p->context->task;
+    int rowFrom, rowTo;
+    matrixTaskRows(p, &rowFrom, &rowTo);
+    fillMatrixRows(&task->to, task->cols, task->min, task->max, task->seed,
+                   rowFrom, rowTo);
+}
+
+
+void relax_rows_duplicate(struct thread_args *p){
+    struct matrixTask *task = &p->context->task;
+    int rowFrom, rowTo;
+    matrixTaskRows(p, &rowFrom, &rowTo);
+    copyMatrixRows(&task->from, &task->to, task->cols, rowFrom, rowTo);
+}
+
+
+void relax_rows_same(struct thread_args *p){
+    //---------------------------------------------------------------
+    // Compares the interior rows of this thread's share, leaving 1 in
+    // its residual when they match to the precision.
+    //---------------------------------------------------------------
+    struct matrixTask *task = &p->context->task;
+    int rowFrom, rowTo;
+    matrixTaskRows(p, &rowFrom, &rowTo);
+    rowFrom = (rowFrom < 1) ? 1 : rowFrom;
+    rowTo = (rowTo > task->rows-2) ? task->rows-2 : rowTo;
+    p->context->residuals[p->threadNumber].value =
+        sameMatrixRowsToPrecision(&task->from, &task->to, task->cols,
+                                  task->precision, rowFrom, rowTo);
+}
+
+
+void relax_rows_difference(struct thread_args *p){
+    struct matrixTask *task = &p->context->task;
+    int rowFrom, rowTo;
+    matrixTaskRows(p, &rowFrom, &rowTo);
+    rowFrom = (rowFrom < 1) ? 1 : rowFrom;
+    rowTo = (rowTo > task->rows-2) ? task->rows-2 : rowTo;
+    p->context->residuals[p->threadNumber].value =
+        maxMatrixRowsDifference(&task->from, &task->to, task->cols,
+                                rowFrom, rowTo);
+}
+
+
+void volumeTaskPlanes(struct thread_args *p, int *planeFrom, int *planeTo){
+    struct volume *volume = p->context->task.toVolume;
+    splitRows(0, volume->planes-1, p->threadNumber, p->totalThreads,
+              planeFrom, planeTo);
+}
+
+
+void relax_planes_fill(struct thread_args *p){
+    struct matrixTask *task = &p->context->task;
+    int planeFrom, planeTo;
+    volumeTaskPlanes(p, &planeFrom, &planeTo);
+    fillVolumePlanes(task->toVolume, task->min, task->max, task->seed,
+                     planeFrom, planeTo);
+}
+
+
+void relax_planes_duplicate(struct thread_args *p){
+    struct matrixTask *task = &p->context->task;
+    int planeFrom, planeTo;
+    volumeTaskPlanes(p, &planeFrom, &planeTo);
+    copyVolumePlanes(task->fromVolume, task->toVolume, planeFrom, planeTo);
+}
+
+
+void relax_planes_same(struct thread_args *p){
+    struct matrixTask *task = &p->context->task;
+    int planeFrom, planeTo;
+    volumeTaskPlanes(p, &planeFrom, &planeTo);
+    planeFrom = (planeFrom < 1) ? 1 : planeFrom;
+    planeTo = (planeTo > task->toVolume->planes-2) ? task->toVolume->planes-2
+                                                   : planeTo;
+    p->context->residuals[p->threadNumber].value =
+        sameVolumePlanesToPrecision(task->fromVolume, task->toVolume,
+                                    task->precision, planeFrom, planeTo);
+}
+
+
+void relax_planes_difference(struct thread_args *p){
+    struct matrixTask *task = &p->context->task;
+    int planeFrom, planeTo;
+    volumeTaskPlanes(p, &planeFrom, &planeTo);
+    planeFrom = (planeFrom < 1) ? 1 : planeFrom;
+    planeTo = (planeTo > task->toVolume->planes-2) ? task->toVolume->planes-2
+                                                   : planeTo;
+    p->context->residuals[p->threadNumber].value =
+        maxVolumePlanesDifference(task->fromVolume, task->toVolume,
+                                  planeFrom, planeTo);
+}
+
+
+void relax_context_fill(struct relaxContext *ctx, double ***matrix,
+                        int rows, int cols, double min, double max,
+                        unsigned int seed){
+
+    //---------------------------------------------------------------
+    // fillMatrix on the pool's threads, giving the same matrix for
+    // the same seed whatever the number of threads.
+    //---------------------------------------------------------------
+    struct matrixTask task = {NULL, *matrix, rows, cols, min, max, seed, 0.0};
+    ctx->task = task;
+    relax_context_run(ctx, &relax_rows_fill);
+}
+
+
+void relax_context_copy(struct relaxContext *ctx, double ***from,
+                        double ***to, int rows, int cols){
+    struct matrixTask task = {*from, *to, rows, cols, 0.0, 0.0, 0, 0.0};
+    ctx->task = task;
+    relax_context_run(ctx, &relax_rows_duplicate);
+}
+
+
+double **relax_context_clone(struct relaxContext *ctx, double ***from,
+                             int rows, int cols){
+    double **clone = createMatrix(rows, cols);
+    relax_context_copy(ctx, from, &clone, rows, cols);
+    return clone;
+}
+
+
+int relax_context_same(struct relaxContext *ctx, double ***a, double ***b,
+                       int rows, int cols, double precision){
+
+    //---------------------------------------------------------------
+    // sameMatrixToPrecision on the pool's threads
+    //---------------------------------------------------------------
+    struct matrixTask task = {*a, *b, rows, cols, 0.0, 0.0, 0, precision};
+    ctx->task = task;
+    relax_context_run(ctx, &relax_rows_same);
+
+    for (int i=0; i<ctx->threads; i++){
+        if (ctx->residuals[i].value == 0.0){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+double relax_context_max_difference(struct relaxContext *ctx, double ***a,
+                                    double ***b, int rows, int cols){
+
+    //---------------------------------------------------------------
+    // maxMatrixRowsDifference of the interior rows on the pool's
+    // threads
+    //---------------------------------------------------------------
+    struct matrixTask task = {*a, *b, rows, cols, 0.0, 0.0, 0, 0.0};
+    ctx->task = task;
+    relax_context_run(ctx, &relax_rows_difference);
+
+    double max = 0.0;
+    for (int i=0; i<ctx->threads; i++){
+        if (ctx->residuals[i].value > max){
+            max = ctx->residuals[i].value;
+        }
+    }
+    return max;
+}
+
+
+//-------------------------------------------------------------------
+// The same for volumes, shared out by planes.
+//-------------------------------------------------------------------
+void relax_context_fill_volume(struct relaxContext *ctx,
+                               struct volume *volume, double min, double max,
+                               unsigned int seed){
+    struct matrixTask task = {NULL, NULL, 0, 0, min, max, seed, 0.0,
+                              NULL, volume};
+    ctx->task = task;
+    relax_context_run(ctx, &relax_planes_fill);
+}
+
+
+void relax_context_copy_volume(struct relaxContext *ctx,
+                               struct volume *from, struct volume *to){
+    struct matrixTask task = {NULL, NULL, 0, 0, 0.0, 0.0, 0, 0.0, from, to};
+    ctx->task = task;
+    relax_context_run(ctx, &relax_planes_duplicate);
+}
+
+
+int relax_context_same_volume(struct relaxContext *ctx, struct volume *a,
+                              struct volume *b, double precision){
+    struct matrixTask task = {NULL, NULL, 0, 0, 0.0, 0.0, 0, precision, a, b};
+    ctx->task = task;
+    relax_context_run(ctx, &relax_planes_same);
+
+    for (int i=0; i<ctx->threads; i++){
+        if (ctx->residuals[i].value == 0.0){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+double relax_context_max_volume_difference(struct relaxContext *ctx,
+                                           struct volume *a,
+                                           struct volume *b){
+    struct matrixTask task = {NULL, NULL, 0, 0, 0.0, 0.0, 0, 0.0, a, b};
+    ctx->task = task;
+    relax_context_run(ctx, &relax_planes_difference);
+
+    double max = 0.0;
+    for (int i=0; i<ctx->threads; i++){
+        if (ctx->residuals[i].value > max){
+            max = ctx->residuals[i].value;
+        }
+    }
+    return max;
+}
+
+
+void relax_context_prepare_checkpoint(struct relaxContext *ctx,
+                                      double ***matrix, int rows, int cols){
+
+    //---------------------------------------------------------------
+    // The buffer starts as a copy of the whole matrix, so the edges
+    // threads never copy are already in it, and the writer thread is
+    // started the first time it is needed.
+    //---------------------------------------------------------------
+    if (ctx->checkpointRows != rows || ctx->checkpointCols != cols){
+        if (ctx->checkpointBuffer != NULL){
+            freeMatrix(&ctx->checkpointBuffer);
+        }
+        ctx->checkpointBuffer = createMatrix(rows, cols);
+        ctx->checkpointRows = rows;
+        ctx->checkpointCols = cols;
+    }
+    copyMatrix(matrix, &ctx->checkpointBuffer, rows, cols);
+
+    ctx->checkpointHeader.rows = rows;
+    ctx->checkpointHeader.cols = cols;
+    ctx->checkpointDue[0] = -1;
+    ctx->checkpointDue[1] = -1;
+
+    if (!ctx->checkpointWriterStarted){
+        pthread_create(&ctx->checkpointWriter, NULL,
+                       &relax_checkpoint_thread, ctx);
+        ctx->checkpointWriterStarted = 1;
+    }
+}
+
+
+void relax_context_prepare(struct relaxContext *ctx, double ***matrix,
+                           int rows, int cols){
+
+    if (ctx->options.checkpointPath != NULL){
+        relax_context_prepare_checkpoint(ctx, matrix, rows, cols);
+    }
+
+    //---------------------------------------------------------------
+    // Multigrid keeps its own levels, the finest being the caller's
+    // matrix itself.
+    //---------------------------------------------------------------
+    if (ctx->options.method == METHOD_MULTIGRID){
+        if (ctx->levelRows != rows || ctx->levelCols != cols){
+            if (ctx->levels != NULL){
+                freeMultigridLevels(ctx->levels, ctx->levelCount);
+            }
+            ctx->levels = createMultigridLevels(rows, cols, &ctx->levelCount);
+            ctx->levelRows = rows;
+            ctx->levelCols = cols;
+        }
+        ctx->levels[0].u = *matrix;
+        return;
+    }
+
+
+    //---------------------------------------------------------------
+    // Red black methods work in place, so only Jacobi needs the
+    // scratch matrix, and it is only made the first time it is needed,
+    // or again when numa or hugepages now ask for it to be placed
+    // differently.
+    //---------------------------------------------------------------
+    if (ctx->options.method != METHOD_JACOBI){
+        return;
+    }
+    if (ctx->lastMatrix != NULL &&
+        (ctx->lastMatrixMapped != (ctx->options.numa ||
+                                   ctx->options.hugePages) ||
+         ctx->lastMatrixHugePages != ctx->options.hugePages)){
+        relax_context_free_scratch(ctx);
+    }
+    if (ctx->lastMatrix == NULL){
+        ctx->lastMatrixMapped = ctx->options.numa || ctx->options.hugePages;
+        ctx->lastMatrixHugePages = ctx->options.hugePages;
+
+        if (ctx->lastMatrixMapped){
+            ctx->lastMatrix = createMatrixMapped(rows, cols,
+                                                 ctx->options.hugePages);
+        }
+        else{
+            ctx->lastMatrix = createMatrix(rows, cols);
+        }
+    }
+
+    if (ctx->options.numa){
+        relax_context_run(ctx, &relax_rows_copy);
+    }
+    else{
+        copyMatrix(matrix, &ctx->lastMatrix, rows, cols);
+    }
+
+
+    //---------------------------------------------------------------
+    // Grow the tile buffers if the tile shape or depth now needs
+    // more room than before.
+    //---------------------------------------------------------------
+    int depth = ctx->options.temporalDepth;
+    if (depth > 0){
+        size_t length = (size_t)(ctx->options.tileRows + 2*depth) *
+                        (ctx->options.tileCols + 2*depth);
+        if (length > ctx->tileBufferLength){
+            for (int i=0; i<ctx->threads; i++){
+                free(ctx->tileBuffers[i]);
+                ctx->tileBuffers[i] = malloc(2*length*sizeof(double));
+                if (ctx->tileBuffers[i] == NULL){
+                    printf("Tile buffer is null so exiting");
+                    exit(0);
+                }
+            }
+            ctx->tileBufferLength = length;
+        }
+
+        int stride = (depth + 7) / 8 * 8;
+        if (stride > ctx->sweepStride){
+            free(ctx->sweepResiduals);
+            if (posix_memalign((void **)&ctx->sweepResiduals, CACHE_LINE,
+                               2*ctx->threads*stride*sizeof(double)) != 0){
+                printf("Sweep residuals are null so exiting");
+                exit(0);
+            }
+            ctx->sweepStride = stride;
+        }
+
+        ctx->tileCounter[0].maxBits = 0;
+        ctx->tileCounter[1].maxBits = 0;
+    }
+}
+
+
+void relax_context_print_balance(struct relaxContext *ctx){
+    //---------------------------------------------------------------
+    // Prints how long each thread spent relaxing and waiting, and
+    // how far the busiest thread was above the average.
+    //---------------------------------------------------------------
+    double total = 0.0;
+    double busiest = 0.0;
+
+    printf("Thread    busy (s)    wait (s)    chunks    stolen\n");
+    for (int i=0; i<ctx->threads; i++){
+        struct threadStats *stats = &ctx->stats[i];
+        printf("%-6d    %8.4f    %8.4f    %6ld    %6ld\n", i,
+               stats->busySeconds, stats->waitSeconds,
+               stats->chunks, stats->steals);
+
+        total += stats->busySeconds;
+        if (stats->busySeconds > busiest){
+            busiest = stats->busySeconds;
+        }
+    }
+
+    double average = total / ctx->threads;
+    if (average > 0.0){
+        printf("Busiest thread was %.3f times the average\n",
+               busiest / average);
+    }
+}
+
+
+void relax_context_print_profile(struct relaxContext *ctx){
+    //---------------------------------------------------------------
+    // Prints where each thread's time went in the last solve, and
+    // the largest change on the first, every power of ten and the
+    // last sweep checked.
+    //---------------------------------------------------------------
+    const char *names[PHASE_COUNT] = {"compute", "check", "barrier", "serial"};
+    double totals[PHASE_COUNT] = {0.0};
+
+    printf("Thread  ");
+    for (int f=0; f<PHASE_COUNT; f++){
+        printf("  %7s (s)", names[f]);
+    }
+    printf("  waiting\n");
+    for (int i=0; i<ctx->threads; i++){
+        double all = 0.0;
+        printf("%-6d  ", i);
+        for (int f=0; f<PHASE_COUNT; f++){
+            printf("  %11.4f", ctx->phases[i].seconds[f]);
+            totals[f] += ctx->phases[i].seconds[f];
+            all += ctx->phases[i].seconds[f];
+        }
+        printf("  %6.1f%%\n", all > 0.0 ?
+               100.0 * ctx->phases[i].seconds[PHASE_BARRIER] / all : 0.0);
+    }
+
+    double all = 0.0;
+    printf("All     ");
+    for (int f=0; f<PHASE_COUNT; f++){
+        printf("  %11.4f", totals[f]);
+        all += totals[f];
+    }
+    printf("  %6.1f%%\n", all > 0.0 ? 100.0 * totals[PHASE_BARRIER] / all : 0.0);
+
+    int last = ctx->residualCount - 1;
+    if (last < 0){
+        return;
+    }
+    printf("Largest change by sweep:");
+    int next = 1;
+    for (int r=0; r<=last; r++){
+        struct residualSample *sample = &ctx->residualHistory[r];
+        if (sample->sweep >= next || r == last){
+            printf(" %d %.3e%s", sample->sweep, sample->residual,
+                   r == last ? "" : ",");
+            while (next <= sample->sweep){
+                next *= 10;
+            }
+        }
+    }
+    printf("\n");
+}
+
+
+void relax_context_write_trace(struct relaxContext *ctx, const char *path){
+    //---------------------------------------------------------------
+    // Writes every phase of every thread in the last solve as a
+    // Chrome trace, which chrome://tracing or Perfetto can show as a
+    // timeline, with the largest change of each checked sweep as a
+    // counter.
+    //---------------------------------------------------------------
+    const char *names[PHASE_COUNT] = {"compute", "check", "barrier", "serial"};
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL){
+        relaxFailure(ctx, "Could not write trace '%s'.", path);
+        return;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (int i=0; i<ctx->threads; i++){
+        fprintf(file, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+                      "\"tid\": %d, \"args\": {\"name\": \"thread %d\"}},\n", i, i);
+    }
+    for (int i=0; i<ctx->threads; i++){
+        struct thread_args *p = &ctx->args[i];
+        for (int e=0; e<p->eventCount; e++){
+            struct traceEvent *event = &p->events[e];
+            fprintf(file, "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, "
+                          "\"tid\": %d, \"ts\": %.3f, \"dur\": %.3f},\n",
+                    names[event->phase], i, event->start * 1e6,
+                    (event->end - event->start) * 1e6);
+        }
+    }
+    for (int r=0; r<ctx->residualCount; r++){
+        struct residualSample *sample = &ctx->residualHistory[r];
+        fprintf(file, "{\"name\": \"largest change\", \"ph\": \"C\", \"pid\": 1, "
+                      "\"ts\": %.3f, \"args\": {\"change\": %.9g}},\n",
+                sample->time * 1e6, sample->residual);
+    }
+    fprintf(file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+                  "\"args\": {\"name\": \"relax\"}}\n]}\n");
+    fclose(file);
+}
+
+
+void relax_context_write_history(struct relaxContext *ctx, const char *path){
+    //---------------------------------------------------------------
+    // Writes the stopping norm of every checked sweep of the last
+    // solve as CSV, with the seconds since the solve started.
+    //---------------------------------------------------------------
+    FILE *file = fopen(path, "w");
+    if (file == NULL){
+        relaxFailure(ctx, "Could not write history '%s'.", path);
+        return;
+    }
+
+    double start = ctx->solveStart - ctx->profileOrigin;
+    fprintf(file, "sweep,seconds,norm\n");
+    for (int r=0; r<ctx->residualCount; r++){
+        struct residualSample *sample = &ctx->residualHistory[r];
+        fprintf(file, "%d,%.6f,%.9g\n", sample->sweep, sample->time - start,
+                sample->residual);
+    }
+    fclose(file);
+}
+
+
+void relax_context_report(struct relaxContext *ctx){
+    //---------------------------------------------------------------
+    // Prints the profile and writes the trace and history asked for,
+    // once a solve is done.
+    //---------------------------------------------------------------
+    if (!ctx->quiet && ctx->profiling){
+        relax_context_print_profile(ctx);
+    }
+    if (ctx->options.tracePath != NULL){
+        relax_context_write_trace(ctx, ctx->options.tracePath);
+    }
+    if (ctx->options.historyPath != NULL){
+        relax_context_write_history(ctx, ctx->options.historyPath);
+    }
+}
+
+
+void printStopReason(int stopReason){
+    //---------------------------------------------------------------
+    // Says why a solve stopped when it did not settle.
+    //---------------------------------------------------------------
+    if (stopReason == STOPPED_SWEEPS){
+        printf("Stopped early, reached the most sweeps allowed\n");
+    }
+    else if (stopReason == STOPPED_TIME){
+        printf("Stopped early, ran out of time\n");
+    }
+    else if (stopReason == STOPPED_STAGNATED){
+        printf("Stopped early, the change stopped falling\n");
+    }
+}
+
+
+int relax_context_sweep_float(struct relaxContext *ctx, double ***matrix,
+                              int rows, int cols, double precision){
+
+    //---------------------------------------------------------------
+    // Rounds the matrix to floats, sweeps them until they settle and
+    // writes the answer back to the matrix. Returns the sweeps taken.
+    //---------------------------------------------------------------
+    if (ctx->floatRows != rows || ctx->floatCols != cols){
+        if (ctx->floatMatrix != NULL){
+            freeMatrixFloat(&ctx->floatMatrix);
+            freeMatrixFloat(&ctx->floatLastMatrix);
+        }
+        ctx->floatMatrix = createMatrixFloat(rows, cols);
+        ctx->floatLastMatrix = createMatrixFloat(rows, cols);
+        ctx->floatRows = rows;
+        ctx->floatCols = cols;
+    }
+
+    double largest = convertMatrixToFloat(matrix, &ctx->floatMatrix, rows, cols);
+    memcpy(ctx->floatLastMatrix[0], ctx->floatMatrix[0],
+           (size_t)rows*cols*sizeof(float));
+    double target = relaxFloatTarget(ctx->options.dataType, precision, largest,
+                                     ctx->quiet);
+
+    for (int i=0; i<ctx->threads; i++){
+        ctx->args[i].floatMatrix = &ctx->floatMatrix;
+        ctx->args[i].floatLastMatrix = &ctx->floatLastMatrix;
+        ctx->args[i].precision = target;
+    }
+    for (int i=0; i<3; i++){
+        ctx->reduction[i].maxBits = 0;
+    }
+
+    relax_context_run(ctx, &relax_rows_float);
+
+    for (int i=0; i<ctx->threads; i++){
+        ctx->args[i].precision = precision;
+    }
+    convertMatrixToDouble(&ctx->floatMatrix, matrix, rows, cols);
+
+    if (!ctx->quiet){
+        if (!sameFloatToPrecision(ctx->result.residual, 0.0f, target)){
+            printf("Floats stopped settling at %e.\n", ctx->result.residual);
+        }
+        printf("Floats finished after %d steps, ", ctx->result.sweeps);
+        printf("largest change %e\n", ctx->result.residual);
+    }
+    return ctx->result.sweeps;
+}
+
+
+struct relaxResult relax_context_solve(struct relaxContext *ctx,
+                                       double ***matrix, int rows, int cols,
+                                       double precision){
+
+    int threads = ctx->threads;
+
+    if (!ctx->quiet){
+        printf("Starting relaxation of %d x %d ", rows, cols);
+        printf("matrix with %d threads to precision %f\n", threads, precision);
+    }
+
+    relax_context_assign_rows(ctx, rows, cols);
+    for (int i=0; i<threads; i++){
+        ctx->args[i].matrix = matrix;
+        ctx->args[i].precision = precision;
+    }
+    ctx->checkpointHeader.precision = precision;
+
+    if (ctx->options.checkEvery < 1){
+        ctx->options.checkEvery = 1;
+    }
+
+    ctx->profiling = ctx->options.profile || ctx->options.tracePath != NULL;
+    ctx->recording = ctx->profiling || ctx->options.historyPath != NULL;
+    if (ctx->recording){
+        if (ctx->profileOrigin == 0.0){
+            ctx->profileOrigin = nowSeconds();
+        }
+        memset(ctx->phases, 0, threads*sizeof(struct phaseStats));
+        ctx->residualCount = 0;
+        for (int i=0; i<threads; i++){
+            ctx->args[i].eventCount = 0;
+        }
+    }
+    ctx->residualSweepBase = 0;
+    ctx->solveStart = nowSeconds();
+    ctx->result.stopReason = STOPPED_SETTLED;
+
+
+    //---------------------------------------------------------------
+    // Float sweeps either are the whole solve, or bring the matrix
+    // most of the way for the double sweeps to finish.
+    //---------------------------------------------------------------
+    int floatSweeps = 0;
+    if (ctx->options.dataType != DTYPE_DOUBLE){
+        floatSweeps = relax_context_sweep_float(ctx, matrix, rows, cols,
+                                                precision);
+        if (ctx->options.dataType == DTYPE_FLOAT){
+            relax_context_report(ctx);
+            return ctx->result;
+        }
+        ctx->residualSweepBase = floatSweeps;
+    }
+
+    relax_context_prepare(ctx, matrix, rows, cols);
+
+    double **callerMatrix = *matrix;
+    for (int i=0; i<threads; i++){
+        ctx->rowsComplete[i] = 0;
+        ctx->residuals[i].value = 0.0;
+        memset(&ctx->stats[i], 0, sizeof(struct threadStats));
+        resetChunkQueue(ctx, 0, i, rows);
+        resetChunkQueue(ctx, 1, i, rows);
+        ctx->haloPublished[i].value = 0;
+        ctx->haloTakenAbove[i].value = 0;
+        ctx->haloTakenBelow[i].value = 0;
+        memset(&ctx->progress[i], 0, sizeof(struct asyncProgress));
+    }
+    ctx->asyncMarked = 0;
+    ctx->asyncDone = 0;
+    for (int i=0; i<3; i++){
+        ctx->reduction[i].maxBits = 0;
+        ctx->haloArrived[i].value = 0;
+    }
+
+    relax_context_run(ctx, &relax_rows);
+    relax_checkpoint_wait(ctx);
+
+
+    //---------------------------------------------------------------
+    // The matrices are swapped every step, so the answer may have
+    // finished in the scratch matrix. Copy it back into the caller's
+    // matrix so each keeps its own buffer.
+    //---------------------------------------------------------------
+    if (*matrix != callerMatrix){
+        copyMatrix(matrix, &ctx->lastMatrix, rows, cols);
+        swapMatrix(matrix, &ctx->lastMatrix);
+    }
+
+    if (!ctx->quiet){
+        if (ctx->options.method == METHOD_MULTIGRID){
+            printf("Matrix finished after %d cycles, ", ctx->result.cycles);
+        }
+        else{
+            printf("Matrix finished after %d steps, ", ctx->result.sweeps);
+            if (ctx->options.sweepsBefore > 0){
+                printf("%ld in all, ", ctx->options.sweepsBefore +
+                                       ctx->result.sweeps);
+            }
+        }
+        printf("largest change %e\n", ctx->result.residual);
+        printStopReason(ctx->result.stopReason);
+
+        if (ctx->options.schedule == SCHEDULE_STEAL &&
+            ctx->options.method == METHOD_JACOBI &&
+            ctx->options.temporalDepth == 0){
+            relax_context_print_balance(ctx);
+        }
+        if (ctx->options.convergence == CONVERGE_ASYNC){
+            int fewest = ctx->progress[0].sweeps;
+            for (int i=1; i<threads; i++){
+                if (ctx->progress[i].sweeps < fewest){
+                    fewest = ctx->progress[i].sweeps;
+                }
+            }
+            printf("Threads swept their rows %d to %d times\n", fewest,
+                   ctx->result.sweeps);
+        }
+    }
+    relax_context_report(ctx);
+
+    ctx->result.sweeps += floatSweeps;
+    return ctx->result;
+}
+
+
+void volumeDecompose(int planes, int rows, int threads,
+                     int *planeParts, int *rowParts){
+
+    //---------------------------------------------------------------
+    // Splits a volume's interior between the threads as planeParts
+    // slabs of planes each cut into rowParts pencils of rows, the
+    // two multiplying to the threads. Picks the split with the
+    // smallest largest share, preferring slabs on a tie as their
+    // planes are contiguous. Both are left 0 when no split gives
+    // every thread at least one plane and one row.
+    //---------------------------------------------------------------
+    *planeParts = 0;
+    *rowParts = 0;
+    long best = 0;
+    for (int pp=threads; pp>=1; pp--){
+        int pr = threads / pp;
+        if (pp*pr != threads || pp > planes-2 || pr > rows-2){
+            continue;
+        }
+        long share = (long)((planes-2 + pp-1) / pp) * ((rows-2 + pr-1) / pr);
+        if (*planeParts == 0 || share < best){
+            best = share;
+            *planeParts = pp;
+            *rowParts = pr;
+        }
+    }
+}
+
+
+void relax_context_assign_volume(struct relaxContext *ctx,
+                                 struct volume *volume){
+
+    //---------------------------------------------------------------
+    // Gives each thread its block of interior planes and rows
+    //---------------------------------------------------------------
+    volumeDecompose(volume->planes, volume->rows, ctx->threads,
+                    &ctx->volumePlaneParts, &ctx->volumeRowParts);
+    if (ctx->volumePlaneParts == 0){
+        printf("Volume can not be split into a block with a plane and a row for each of %d threads.\n",
+               ctx->threads);
+        exit(0);
+    }
+
+    for (int i=0; i<ctx->threads; i++){
+        struct thread_args *p = &ctx->args[i];
+        splitRows(1, volume->planes-2, i / ctx->volumeRowParts,
+                  ctx->volumePlaneParts, &p->planeFrom, &p->planeTo);
+        splitRows(1, volume->rows-2, i % ctx->volumeRowParts,
+                  ctx->volumeRowParts, &p->rowFrom, &p->rowTo);
+    }
+
+    relax_context_place_threads(ctx);
+}
+
+
+void copyVolumeBlock(struct thread_args *p, const struct volume *from,
+                     struct volume *to, int withBoundary){
+
+    //---------------------------------------------------------------
+    // Copies this thread's block, and with withBoundary the boundary
+    // planes and rows next to it at the edges of the volume, so the
+    // blocks together cover every cell.
+    //---------------------------------------------------------------
+    int planeFrom = p->planeFrom;
+    int planeTo = p->planeTo;
+    int rowFrom = p->rowFrom;
+    int rowTo = p->rowTo;
+    if (withBoundary){
+        planeFrom = (planeFrom == 1) ? 0 : planeFrom;
+        planeTo = (planeTo == from->planes-2) ? from->planes-1 : planeTo;
+        rowFrom = (rowFrom == 1) ? 0 : rowFrom;
+        rowTo = (rowTo == from->rows-2) ? from->rows-1 : rowTo;
+    }
+    for (int k=planeFrom; k<=planeTo; k++){
+        for (int i=rowFrom; i<=rowTo; i++){
+            memcpy(volumeRow(to, k, i), volumeRow(from, k, i),
+                   from->cols*sizeof(double));
+        }
+    }
+}
+
+
+void measureChangeVolumeBlock(struct thread_args *p,
+                              const struct volume *now,
+                              const struct volume *before,
+                              struct changeNorms *norms){
+    for (int k=p->planeFrom; k<=p->planeTo; k++){
+        for (int i=p->rowFrom; i<=p->rowTo; i++){
+            measureChangeRow(volumeRow(now, k, i), volumeRow(before, k, i),
+                             1, now->cols-2, norms);
+        }
+    }
+}
+
+
+void relax_volume_reduce(struct thread_args *p){
+
+    //---------------------------------------------------------------
+    // Jacobi sweeps of a volume, each thread relaxing its block in
+    // tiles, with the largest changes combined as in
+    // relax_rows_reduce, one barrier a sweep. The scratch volume
+    // starts as a copy so it holds the boundary, each thread
+    // copying its own share.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = p->context;
+    struct volume *current = ctx->volume;
+    struct volume *previous = &ctx->lastVolume;
+    int checkEvery = ctx->options.checkEvery;
+    int threadNumber = p->threadNumber;
+    int measuring = (ctx->options.stopRule != STOP_CHANGE);
+    long cells = (long)(current->planes-2)*(current->rows-2)*(current->cols-2);
+    struct stopState stop = {0.0, 0};
+
+    copyVolumeBlock(p, current, previous, 1);
+    pthread_barrier_wait(p->barrier);
+
+    int count = 0;
+    while (1){
+
+        double phase = phaseStart(p);
+        double local = relaxVolumeBlock(current, previous,
+                                        p->planeFrom, p->planeTo,
+                                        p->rowFrom, p->rowTo,
+                                        ctx->options.volumeTileRows,
+                                        ctx->options.volumeTileCols);
+        struct volume *temp = current;
+        current = previous;
+        previous = temp;
+        count++;
+        phaseEnd(p, PHASE_COMPUTE, phase);
+
+        phase = phaseStart(p);
+        int check = (count % checkEvery == 0);
+        if (check){
+            atomicMaxResidual(&ctx->reduction[count % 3].maxBits, local);
+            if (measuring){
+                struct changeNorms norms = {local, 0.0, 0.0};
+                measureChangeVolumeBlock(p, current, previous, &norms);
+                ctx->norms[(count % 2)*p->totalThreads + threadNumber].norms =
+                    norms;
+            }
+        }
+        phaseEnd(p, PHASE_CHECK, phase);
+        if (threadNumber == 0){
+            phase = phaseStart(p);
+            __atomic_store_n(&ctx->reduction[(count+1) % 3].maxBits, 0,
+                             __ATOMIC_RELAXED);
+            if (check){
+                relaxBudgetCheck(ctx, count);
+            }
+            phaseEnd(p, PHASE_SERIAL, phase);
+        }
+
+        phase = phaseStart(p);
+        pthread_barrier_wait(p->barrier);
+        phaseEnd(p, PHASE_BARRIER, phase);
+
+        if (check){
+            phase = phaseStart(p);
+            double global = loadResidual(&ctx->reduction[count % 3].maxBits);
+            double norm = relaxGlobalNormOf(p, count, global, cells);
+            int reason = relaxStopReason(&ctx->options, &stop, count, norm,
+                                         p->precision,
+                                         ctx->budgetSpent[count % 3]);
+            if (threadNumber == 0){
+                recordResidual(ctx, count, norm);
+                if (reason >= 0){
+                    ctx->result.stopReason = reason;
+                }
+            }
+            phaseEnd(p, PHASE_CHECK, phase);
+            if (reason >= 0){
+                break;
+            }
+        }
+    }
+
+
+    //---------------------------------------------------------------
+    // Every thread only wrote its own block, so each can copy its
+    // block of an answer that finished in the scratch volume back
+    // without waiting for the others.
+    //---------------------------------------------------------------
+    if (current != ctx->volume){
+        copyVolumeBlock(p, current, ctx->volume, 0);
+    }
+    if (threadNumber == 0){
+        ctx->result.sweeps = count;
+        ctx->result.residual = loadResidual(&ctx->reduction[count % 3].maxBits);
+    }
+}
+
+
+struct relaxResult relax_context_solve_volume(struct relaxContext *ctx,
+                                              struct volume *volume,
+                                              double precision){
+
+    //---------------------------------------------------------------
+    // Solves a volume in place with the 7 point stencil. Jacobi is
+    // the only method, and as with matrices the answer and sweeps
+    // are the same on any number of threads. The scratch volume is
+    // kept for the next solve of the same size.
+    //---------------------------------------------------------------
+    int threads = ctx->threads;
+
+    if (!ctx->quiet){
+        printf("Starting relaxation of %d x %d x %d ", volume->planes,
+               volume->rows, volume->cols);
+        printf("volume with %d threads to precision %f\n", threads, precision);
+    }
+
+    relax_context_assign_volume(ctx, volume);
+    for (int i=0; i<threads; i++){
+        ctx->args[i].precision = precision;
+    }
+    if (ctx->options.checkEvery < 1){
+        ctx->options.checkEvery = 1;
+    }
+
+    if (ctx->lastVolume.planes != volume->planes ||
+        ctx->lastVolume.rows != volume->rows ||
+        ctx->lastVolume.cols != volume->cols){
+        volumeFree(&ctx->lastVolume);
+        ctx->lastVolume = volumeAlloc(volume->planes, volume->rows,
+                                      volume->cols);
+    }
+
+    ctx->profiling = ctx->options.profile || ctx->options.tracePath != NULL;
+    ctx->recording = ctx->profiling || ctx->options.historyPath != NULL;
+    if (ctx->recording){
+        if (ctx->profileOrigin == 0.0){
+            ctx->profileOrigin = nowSeconds();
+        }
+        memset(ctx->phases, 0, threads*sizeof(struct phaseStats));
+        ctx->residualCount = 0;
+        for (int i=0; i<threads; i++){
+            ctx->args[i].eventCount = 0;
+        }
+    }
+    ctx->residualSweepBase = 0;
+    ctx->solveStart = nowSeconds();
+    ctx->result.stopReason = STOPPED_SETTLED;
+    ctx->result.cycles = 0;
+    for (int i=0; i<3; i++){
+        ctx->reduction[i].maxBits = 0;
+    }
+
+    ctx->volume = volume;
+    relax_context_run(ctx, &relax_volume_reduce);
+    ctx->volume = NULL;
+
+    if (!ctx->quiet){
+        printf("Volume finished after %d steps, largest change %e\n",
+               ctx->result.sweeps, ctx->result.residual);
+        printStopReason(ctx->result.stopReason);
+        if (ctx->volumeRowParts == 1){
+            printf("Split into %d slab/s of planes\n", ctx->volumePlaneParts);
+        }
+        else{
+            printf("Split into %d slab/s of %d pencil/s\n",
+                   ctx->volumePlaneParts, ctx->volumeRowParts);
+        }
+    }
+    relax_context_report(ctx);
+    return ctx->result;
+}
+
+
+struct relaxResult relax_context_resolve(struct relaxContext *ctx,
+                                         double ***matrix, int rows, int cols,
+                                         double precision,
+                                         struct boundaryChange *changes,
+                                         int changeCount){
+
+    //---------------------------------------------------------------
+    // Re-solves a previous answer after some of its boundary cells
+    // change. Starting from the old answer it only takes as many
+    // sweeps as the change needs to settle, and with the incremental
+    // option only the rows the change has reached are relaxed.
+    //---------------------------------------------------------------
+    int windowFrom = rows;
+    int windowTo = -1;
+    for (int c=0; c<changeCount; c++){
+        int row = changes[c].row;
+        int col = changes[c].col;
+        if (row < 0 || row >= rows || col < 0 || col >= cols ||
+            (row != 0 && row != rows-1 && col != 0 && col != cols-1)){
+            printf("Cell %d,%d is not on the boundary.\n", row, col);
+            exit(0);
+        }
+        (*matrix)[row][col] = changes[c].value;
+
+        //---------------------------------------------------------------
+        // The interior row next to the cell is the first to feel it,
+        // corner cells are never read.
+        //---------------------------------------------------------------
+        int next = row == 0 ? 1 : row == rows-1 ? rows-2 : row;
+        if ((col == 0 || col == cols-1) && (row == 0 || row == rows-1)){
+            continue;
+        }
+        if (next < windowFrom){
+            windowFrom = next;
+        }
+        if (next > windowTo){
+            windowTo = next;
+        }
+    }
+
+    int windowed = ctx->options.incremental &&
+                   ctx->options.temporalDepth == 0 &&
+                   ctx->options.method != METHOD_MULTIGRID &&
+                   ctx->options.checkpointPath == NULL;
+    if (windowed && windowFrom > windowTo){
+        //---------------------------------------------------------------
+        // Nothing that is read changed, so the answer stands.
+        //---------------------------------------------------------------
+        ctx->result.sweeps = 0;
+        ctx->result.residual = 0.0;
+        ctx->result.cycles = 0;
+        ctx->result.stopReason = STOPPED_SETTLED;
+        return ctx->result;
+    }
+
+    ctx->windowed = windowed;
+    ctx->windowFrom = windowFrom;
+    ctx->windowTo = windowTo;
+    struct relaxResult result = relax_context_solve(ctx, matrix, rows, cols,
+                                                    precision);
+    ctx->windowed = 0;
+    return result;
+}
+
+
+void relax_context_destroy(struct relaxContext *ctx){
+
+    //---------------------------------------------------------------
+    // Wake the workers with the shutdown flag set and wait for them
+    // to exit before releasing anything they might touch.
+    //---------------------------------------------------------------
+    pthread_mutex_lock(&ctx->checkpointLock);
+    ctx->shutdown = 1;
+    pthread_cond_broadcast(&ctx->checkpointChanged);
+    pthread_mutex_unlock(&ctx->checkpointLock);
+    pthread_barrier_wait(&ctx->jobBarrier);
+
+    for (int i=0; i<(ctx->threads-1); i++){
+        pthread_join(ctx->workers[i], NULL);
+    }
+    if (ctx->checkpointWriterStarted){
+        pthread_join(ctx->checkpointWriter, NULL);
+    }
+    pthread_mutex_destroy(&ctx->checkpointLock);
+    pthread_cond_destroy(&ctx->checkpointChanged);
+    free(ctx->pinnedCpuList);
+    if (ctx->checkpointBuffer != NULL){
+        freeMatrix(&ctx->checkpointBuffer);
+    }
+    if (ctx->floatMatrix != NULL){
+        freeMatrixFloat(&ctx->floatMatrix);
+        freeMatrixFloat(&ctx->floatLastMatrix);
+    }
+
+    pthread_barrier_destroy(&ctx->barrier);
+    pthread_barrier_destroy(&ctx->jobBarrier);
+    volumeFree(&ctx->lastVolume);
+
+    relax_context_free_scratch(ctx);
+    if (ctx->rows != 0){
+        freeAssignedRows(&ctx->AR);
+    }
+    free(ctx->rowsComplete);
+    free(ctx->residuals);
+    free(ctx->queues);
+    free(ctx->stats);
+    free(ctx->active);
+    for (int i=0; i<ctx->threads; i++){
+        free(ctx->tileBuffers[i]);
+        gridFree(&ctx->args[i].work[0]);
+        gridFree(&ctx->args[i].work[1]);
+        free(ctx->args[i].events);
+        if (ctx->args[i].halo[0] != NULL){
+            freeMatrix(&ctx->args[i].halo[0]);
+            freeMatrix(&ctx->args[i].halo[1]);
+        }
+        free(ctx->args[i].mailTop[0]);
+    }
+    free(ctx->phases);
+    free(ctx->norms);
+    free(ctx->haloPublished);
+    free(ctx->haloTakenAbove);
+    free(ctx->haloTakenBelow);
+    free(ctx->progress);
+    free(ctx->asyncMark);
+    free(ctx->residualHistory);
+    free(ctx->tileBuffers);
+    free(ctx->sweepResiduals);
+    if (ctx->levels != NULL){
+        freeMultigridLevels(ctx->levels, ctx->levelCount);
+    }
+    free(ctx->args);
+    free(ctx->workers);
+    free(ctx);
+}
+
+
+struct relaxResult relax_async(double ***matrix, int rows, int cols,
+                               int threads,     double precision){
+    //---------------------------------------------------------------
+    // One off parallel solve, for when there is no context to reuse.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = relax_context_create(threads);
+    struct relaxResult result = relax_context_solve(ctx, matrix, rows, cols,
+                                                    precision);
+    relax_context_destroy(ctx);
+    return result;
+}
+
+
+int relaxCheckInterval(struct relaxOptions *options, int rows, int cols,
+                       int threads){
+    //---------------------------------------------------------------
+    // The sweeps between the convergence checks of a solve on this
+    // many threads, so the check function can test on the same
+    // sweeps and stop on the same one. Halo exchange tests every
+    // ghost sweeps, cut as relax_rows_halo cuts them. The flags loop,
+    // temporal blocking and incremental re-solves test every sweep
+    // whatever check is. Float sweeps always go by check.
+    //---------------------------------------------------------------
+    if (options->method == METHOD_JACOBI && options->temporalDepth == 0 &&
+        !options->incremental && options->exchange == EXCHANGE_HALO &&
+        options->convergence != CONVERGE_ASYNC &&
+        !relaxSplitsByColumns(rows, cols, threads)){
+        int depth = options->ghostDepth;
+        if (depth > (rows-2) / threads){
+            depth = (rows-2) / threads;
+        }
+        return depth;
+    }
+    if (options->method == METHOD_JACOBI &&
+        (options->temporalDepth > 0 || options->incremental ||
+         (options->convergence == CONVERGE_FLAGS &&
+          options->schedule != SCHEDULE_STEAL &&
+          options->checkpointPath == NULL && !relaxStopsEarly(options)))){
+        return 1;
+    }
+    return options->checkEvery < 1 ? 1 : options->checkEvery;
+}
+
+
+struct relaxResult relax_sync_jacobi(double ***matrix, int rows, int cols,
+                                     double precision, int verbose,
+                                     struct relaxOptions *options,
+                                     int checkEvery, struct grid work[2]){
+
+    //---------------------------------------------------------------
+    // Jacobi sweeps on one thread until the options' stopping rule
+    // is met, tested every checkEvery sweeps. The sweeps go back and
+    // forth between the two work grids, which are reshaped to fit and
+    // left for the caller to reuse, and the answer is copied back
+    // into the matrix.
+    //---------------------------------------------------------------
+    struct stopState stop = {0.0, 0};
+    long cells = (long)(rows-2)*(cols-2);
+    double start = nowSeconds();
+
+    gridLoad(&work[0], matrix, rows, cols);
+    copyGrid(&work[0], &work[1]);
+    struct grid *current = &work[0];
+    struct grid *previous = &work[1];
+
+    int count = 0;
+    int reason;
+    double residual;
+    do {
+        if (verbose){
+            printf("Matrix after %d step/s\n", count);
+            printGrid(current);
+        }
+
+        struct grid *temp = current;
+        current = previous;
+        previous = temp;
+
+        residual = relaxGridRowsFused(previous, current, 1, rows-2);
+
+        count++;
+        if (count % checkEvery != 0){
+            reason = -1;
+            continue;
+        }
+
+        struct changeNorms norms = {residual, 0.0, 0.0};
+        if (options->stopRule != STOP_CHANGE){
+            measureChangeGridRows(current, previous, 1, rows-2, &norms);
+        }
+        reason = relaxStopReason(options, &stop, count,
+                                 relaxStopNorm(options->stopRule, &norms, cells),
+                                 precision, options->maxSeconds > 0.0 &&
+                                 nowSeconds() - start >= options->maxSeconds);
+
+    } while (reason < 0);
+
+    gridStore(current, matrix);
+
+    struct relaxResult result;
+    result.sweeps = count;
+    result.residual = residual;
+    result.cycles = 0;
+    result.stopReason = reason;
+    return result;
+}
+
+
+struct relaxResult relax_sync_redblack(double ***matrix, int rows, int cols,
+                                       double precision, int verbose,
+                                       struct relaxOptions *options,
+                                       int checkEvery){
+
+    //---------------------------------------------------------------
+    // Red black sweeps work in place so need no second matrix, a
+    // sweep is both colours and its change is the larger of the two.
+    // Every checkEvery'th sweep is tested against the stopping rule.
+    //---------------------------------------------------------------
+    double omega = relaxOmega(options, rows, cols);
+    int measuring = (options->stopRule != STOP_CHANGE);
+    struct stopState stop = {0.0, 0};
+    long cells = (long)(rows-2)*(cols-2);
+    double start = nowSeconds();
+
+    int count = 0;
+    int reason;
+    double residual;
+    do {
+        if (verbose){
+            printf("Matrix after %d step/s\n", count);
+            printMatrix(matrix, rows, cols);
+        }
+
+        int check = ((count+1) % checkEvery == 0);
+        struct changeNorms norms = {0.0, 0.0, 0.0};
+        double red, black;
+        if (measuring && check){
+            red = relaxRowsRedBlackNorms(*matrix, 1, rows-2, 1, cols-2, 0,
+                                         omega, &norms);
+            black = relaxRowsRedBlackNorms(*matrix, 1, rows-2, 1, cols-2, 1,
+                                           omega, &norms);
+        }
+        else{
+            red = relaxRowsRedBlack(*matrix, 1, rows-2, 1, cols-2, 0, omega);
+            black = relaxRowsRedBlack(*matrix, 1, rows-2, 1, cols-2, 1,
+                                      omega);
+        }
+        residual = red > black ? red : black;
+
+        count++;
+        if (!check){
+            reason = -1;
+            continue;
+        }
+
+        norms.max = residual;
+        reason = relaxStopReason(options, &stop, count,
+                                 relaxStopNorm(options->stopRule, &norms, cells),
+                                 precision, options->maxSeconds > 0.0 &&
+                                 nowSeconds() - start >= options->maxSeconds);
+
+    } while (reason < 0);
+
+    struct relaxResult result;
+    result.sweeps = count;
+    result.residual = residual;
+    result.cycles = 0;
+    result.stopReason = reason;
+    return result;
+}
+
+
+struct relaxResult relaxWholeGrid(struct thread_args *p,
+                                  struct relaxGrid *grid, double precision){
+
+    //---------------------------------------------------------------
+    // Solves one grid on this thread alone, sweep for sweep as the
+    // check function does, so there are no barriers at all.
+    //---------------------------------------------------------------
+    struct relaxOptions *options = &p->context->options;
+    int rows = grid->rows;
+    int cols = grid->cols;
+    int checkEvery = relaxCheckInterval(options, rows, cols,
+                                        p->context->threads);
+
+    if (options->method != METHOD_JACOBI){
+        return relax_sync_redblack(&grid->matrix, rows, cols, precision, 0,
+                                   options, checkEvery);
+    }
+
+    return relax_sync_jacobi(&grid->matrix, rows, cols, precision, 0,
+                             options, checkEvery, p->work);
+}
+
+
+void relax_grids_whole(struct thread_args *p){
+    //---------------------------------------------------------------
+    // Threads take whole grids in turn until none are left. Largest
+    // first means the last grids taken are the quickest, so threads
+    // finish close together.
+    //---------------------------------------------------------------
+    struct relaxContext *ctx = p->context;
+    unsigned long long next;
+    while ((next = __atomic_fetch_add(&ctx->batchNext.maxBits, 1,
+                                      __ATOMIC_RELAXED)) < ctx->batchWhole){
+        struct relaxGrid *grid = &ctx->batch[ctx->batchOrder[next]];
+        grid->result = relaxWholeGrid(p, grid, ctx->batchPrecision);
+    }
+}
+
+
+int batchSolvesWhole(struct relaxOptions *options, struct relaxGrid *grid){
+    //---------------------------------------------------------------
+    // Whether a grid of a batch is small enough to solve on one
+    // thread, with options that do not need the threads to share it.
+    // Sources, coefficients and masks are only swept by the threads.
+    //---------------------------------------------------------------
+    return options->method != METHOD_MULTIGRID &&
+           options->dataType == DTYPE_DOUBLE &&
+           (options->problem == NULL ||
+            options->problem->kind == PROBLEM_LAPLACE) &&
+           options->mask == NULL &&
+           (size_t)grid->rows*grid->cols <= BATCH_WHOLE_CELLS;
+}
+
+
+int compareGridCells(const void *a, const void *b, void *payload){
+    struct relaxGrid *grids = payload;
+    struct relaxGrid *x = &grids[*(const int *)a];
+    struct relaxGrid *y = &grids[*(const int *)b];
+    size_t cellsX = (size_t)x->rows*x->cols;
+    size_t cellsY = (size_t)y->rows*y->cols;
+    return cellsX < cellsY ? 1 : cellsX > cellsY ? -1 : 0;
+}
+
+
+int relax_context_solve_batch(struct relaxContext *ctx,
+                              struct relaxGrid *grids, int count,
+                              double precision){
+
+    //---------------------------------------------------------------
+    // Solves many independent grids. Small grids spend more time in
+    // barriers than sweeping when split between threads, so each is
+    // solved whole by one thread and the threads work through them
+    // together. Grids above BATCH_WHOLE_CELLS, and every grid when
+    // the options need the threads to share a solve (multigrid,
+    // float sweeps, sources or coefficients and masks), are then
+    // solved one at a time on all threads. Returns the number of
+    // grids solved whole.
+    //---------------------------------------------------------------
+    const struct relaxProblem *problem = ctx->options.problem;
+    const struct cellMask *mask = ctx->options.mask;
+    for (int g=0; g<count; g++){
+        if (problem != NULL && problem->kind != PROBLEM_LAPLACE &&
+            (problem->rows != grids[g].rows ||
+             problem->cols != grids[g].cols)){
+            printf("Batch grid %d is %dx%d but the sources and coefficients are %dx%d.\n",
+                   g, grids[g].rows, grids[g].cols, problem->rows, problem->cols);
+            exit(0);
+        }
+        if (mask != NULL &&
+            (mask->rows != grids[g].rows || mask->cols != grids[g].cols)){
+            printf("Batch grid %d is %dx%d but the mask is %dx%d.\n",
+                   g, grids[g].rows, grids[g].cols, mask->rows, mask->cols);
+            exit(0);
+        }
+    }
+
+    ctx->batchOrder = malloc((count > 0 ? count : 1)*sizeof(int));
+    ctx->batchWhole = 0;
+    for (int g=0; g<count; g++){
+        if (batchSolvesWhole(&ctx->options, &grids[g])){
+            ctx->batchOrder[ctx->batchWhole++] = g;
+        }
+    }
+    qsort_r(ctx->batchOrder, ctx->batchWhole, sizeof(int),
+            &compareGridCells, grids);
+
+    ctx->batch = grids;
+    ctx->batchPrecision = precision;
+    ctx->batchNext.maxBits = 0;
+    relax_context_run(ctx, &relax_grids_whole);
+
+    int quiet = ctx->quiet;
+    ctx->quiet = 1;
+    for (int g=0; g<count; g++){
+        if (batchSolvesWhole(&ctx->options, &grids[g])){
+            continue;
+        }
+        grids[g].result = relax_context_solve(ctx, &grids[g].matrix,
+                                              grids[g].rows, grids[g].cols,
+                                              precision);
+    }
+    ctx->quiet = quiet;
+
+    int whole = ctx->batchWhole;
+    free(ctx->batchOrder);
+    ctx->batchOrder = NULL;
+    ctx->batch = NULL;
+    ctx->batchWhole = 0;
+    return whole;
+}
+
+
+int relax_sync_float(double ***matrix, int rows, int cols, double precision,
+                     int dataType, int checkEvery){
+
+    //---------------------------------------------------------------
+    // The float sweeps of the check function, as the threads do them,
+    // tested every checkEvery sweeps.
+    //---------------------------------------------------------------
+    float **current = createMatrixFloat(rows, cols);
+    float **previous = createMatrixFloat(rows, cols);
+    double largest = convertMatrixToFloat(matrix, &current, rows, cols);
+    memcpy(previous[0], current[0], (size_t)rows*cols*sizeof(float));
+    double target = relaxFloatTarget(dataType, precision, largest, 0);
+
+    int count = 0;
+    float residual;
+    float best = INFINITY;
+    int bestCount = 0;
+    while (1){
+        residual = relaxMatrixBlockFusedFloat(&current, &previous,
+                                              1, rows-2, 1, cols-2);
+        float **temp = current;
+        current = previous;
+        previous = temp;
+        count++;
+
+        if (count % checkEvery != 0){
+            continue;
+        }
+        if (sameFloatToPrecision(residual, 0.0f, target)){
+            break;
+        }
+        if (residual < best){
+            best = residual;
+            bestCount = count;
+        }
+        else if (count - bestCount >= FLOAT_STALL_SWEEPS){
+            printf("Floats stopped settling at %e.\n", residual);
+            break;
+        }
+    }
+
+    convertMatrixToDouble(&current, matrix, rows, cols);
+    printf("Floats finished in %d step/s, largest change %e\n", count,
+           residual);
+
+    freeMatrixFloat(&current);
+    freeMatrixFloat(&previous);
+    return count;
+}
+
+
+struct relaxResult relax_sync_problem(double ***matrix, int rows, int cols,
+                                      double precision, int verbose,
+                                      struct relaxOptions *options,
+                                      int checkEvery){
+
+    //---------------------------------------------------------------
+    // The Jacobi check function for a problem other than Laplace's
+    // or a masked domain, sweeping the matrix and a scratch copy in
+    // turn on one thread, tested every checkEvery sweeps.
+    //---------------------------------------------------------------
+    struct stopState stop = {0.0, 0};
+    long cells = relaxActiveCells(options, rows, cols);
+    double start = nowSeconds();
+
+    double **scratch = cloneMatrix(matrix, rows, cols);
+    double **current = *matrix;
+    double **previous = scratch;
+
+    int count = 0;
+    int reason;
+    double residual;
+    do {
+        if (verbose){
+            printf("Matrix after %d step/s\n", count);
+            printMatrix(&current, rows, cols);
+        }
+
+        residual = relaxMaskedBlock(options->mask, options->problem,
+                                    &current, &previous, cols,
+                                    1, rows-2, 1, cols-2);
+        swapMatrix(&current, &previous);
+        count++;
+        if (count % checkEvery != 0){
+            reason = -1;
+            continue;
+        }
+
+        struct changeNorms norms = {residual, 0.0, 0.0};
+        if (options->stopRule != STOP_CHANGE){
+            measureChangeRows(current, previous, 1, rows-2, 1, cols-2,
+                              &norms);
+        }
+        reason = relaxStopReason(options, &stop, count,
+                                 relaxStopNorm(options->stopRule, &norms, cells),
+                                 precision, options->maxSeconds > 0.0 &&
+                                 nowSeconds() - start >= options->maxSeconds);
+    } while (reason < 0);
+
+    if (current != *matrix){
+        copyMatrix(&current, matrix, rows, cols);
+    }
+    freeMatrix(&scratch);
+
+    struct relaxResult result;
+    result.sweeps = count;
+    result.residual = residual;
+    result.cycles = 0;
+    result.stopReason = reason;
+    return result;
+}
+
+
+struct relaxResult relax_sync(double*** matrix, int rows, int cols,
+                              double precision, int verbose,
+                              struct relaxOptions *options, int threads){
+
+    //---------------------------------------------------------------
+    // The check function, solving on the calling thread alone but
+    // testing for convergence on the same sweeps as a solve on
+    // threads threads, so both stop on the same sweep.
+    //---------------------------------------------------------------
+
+    printf("Starting relaxation of %d x %d ", rows, cols);
+    printf("matrix with check function to precision %f\n", precision);
+
+    struct relaxOptions defaults = relax_default_options();
+    if (options == NULL){
+        options = &defaults;
+    }
+    int checkEvery = relaxCheckInterval(options, rows, cols, threads);
+
+    if (options->method == METHOD_MULTIGRID){
+        //---------------------------------------------------------------
+        // Multigrid only differs between thread counts in who does
+        // which rows, so a context of one thread, which starts no
+        // pthreads, is the check function.
+        //---------------------------------------------------------------
+        struct relaxContext *ctx = relax_context_create(1);
+        ctx->options = *options;
+        struct relaxResult result = relax_context_solve(ctx, matrix, rows, cols,
+                                                        precision);
+        relax_context_destroy(ctx);
+        return result;
+    }
+
+    if (options->method != METHOD_JACOBI){
+        struct relaxResult result = relax_sync_redblack(matrix, rows, cols,
+                                                        precision, verbose,
+                                                        options, checkEvery);
+        printf("Finished in %d step/s, ", result.sweeps);
+        printf("largest change %e\n", result.residual);
+        printStopReason(result.stopReason);
+        if (verbose){
+            printf("Final Matrix\n");
+            printMatrix(matrix, rows, cols);
+            printf("\n");
+        }
+        return result;
+    }
+
+    if (relaxRow == NULL){
+        selectRelaxKernel(KERNEL_AUTO);
+    }
+
+    if ((options->problem != NULL &&
+         options->problem->kind != PROBLEM_LAPLACE) || options->mask != NULL){
+        struct relaxResult result = relax_sync_problem(matrix, rows, cols,
+                                                       precision, verbose,
+                                                       options, checkEvery);
+        printf("Finished in %d step/s, ", result.sweeps);
+        printf("largest change %e\n", result.residual);
+        printStopReason(result.stopReason);
+        if (verbose){
+            printf("Final Matrix\n");
+            printMatrix(matrix, rows, cols);
+            printf("\n");
+        }
+        return result;
+    }
+
+    int floatSweeps = 0;
+    if (options->dataType != DTYPE_DOUBLE){
+        floatSweeps = relax_sync_float(matrix, rows, cols, precision,
+                                       options->dataType,
+                                       options->checkEvery < 1 ? 1 :
+                                       options->checkEvery);
+        if (options->dataType == DTYPE_FLOAT){
+            struct relaxResult result;
+            result.sweeps = floatSweeps;
+            result.residual = 0.0;
+            result.cycles = 0;
+            result.stopReason = STOPPED_SETTLED;
+            return result;
+        }
+    }
+
+    //---------------------------------------------------------------
+    // Iterativley relax matrix until the difference is less than
+    // the precision, in a pair of grids that are freed afterwards.
+    //---------------------------------------------------------------
+    struct grid work[2] = {gridEmpty(), gridEmpty()};
+    struct relaxResult result = relax_sync_jacobi(matrix, rows, cols,
+                                                  precision, verbose,
+                                                  options, checkEvery, work);
+    int count = result.sweeps;
+    result.sweeps += floatSweeps;
+
+    printf("Finished in %d step/s, ", count);
+    printf("largest change %e\n", result.residual);
+    printStopReason(result.stopReason);
+    if (verbose){
+        printf("Final Matrix\n");
+        printMatrix(matrix, rows, cols);
+        printf("\n");
+    }
+
+
+    gridFree(&work[0]);
+    gridFree(&work[1]);
+    return result;
+}
+
+
+struct relaxResult relax_sync_volume(struct volume *volume, double precision,
+                                     struct relaxOptions *options){
+
+    //---------------------------------------------------------------
+    // The check function for volumes, untiled Jacobi sweeps on one
+    // thread until the options' stopping rule is met, tested every
+    // check sweeps as the threads do.
+    //---------------------------------------------------------------
+    printf("Starting relaxation of %d x %d x %d ", volume->planes,
+           volume->rows, volume->cols);
+    printf("volume with check function to precision %f\n", precision);
+
+    if (relaxVolumeRow == NULL){
+        selectRelaxKernel(KERNEL_AUTO);
+    }
+    struct stopState stop = {0.0, 0};
+    long cells = (long)(volume->planes-2)*(volume->rows-2)*(volume->cols-2);
+    int checkEvery = options->checkEvery < 1 ? 1 : options->checkEvery;
+    double start = nowSeconds();
+
+    struct volume scratch = volumeAlloc(volume->planes, volume->rows,
+                                        volume->cols);
+    copyVolumePlanes(volume, &scratch, 0, volume->planes-1);
+    struct volume *current = volume;
+    struct volume *previous = &scratch;
+
+    int count = 0;
+    int reason;
+    double residual;
+    do {
+        residual = relaxVolumeBlock(current, previous, 1, volume->planes-2,
+                                    1, volume->rows-2, volume->rows,
+                                    volume->cols);
+        struct volume *temp = current;
+        current = previous;
+        previous = temp;
+        count++;
+        if (count % checkEvery != 0){
+            reason = -1;
+            continue;
+        }
+
+        struct changeNorms norms = {residual, 0.0, 0.0};
+        if (options->stopRule != STOP_CHANGE){
+            for (int k=1; k<(volume->planes-1); k++){
+                for (int i=1; i<(volume->rows-1); i++){
+                    measureChangeRow(volumeRow(current, k, i),
+                                     volumeRow(previous, k, i), 1,
+                                     volume->cols-2, &norms);
+                }
+            }
+        }
+        reason = relaxStopReason(options, &stop, count,
+                                 relaxStopNorm(options->stopRule, &norms, cells),
+                                 precision, options->maxSeconds > 0.0 &&
+                                 nowSeconds() - start >= options->maxSeconds);
+    } while (reason < 0);
+
+    if (current != volume){
+        copyVolumePlanes(current, volume, 0, volume->planes-1);
+    }
+    volumeFree(&scratch);
+
+    struct relaxResult result;
+    result.sweeps = count;
+    result.residual = residual;
+    result.cycles = 0;
+    result.stopReason = reason;
+
+    printf("Finished in %d step/s, ", count);
+    printf("largest change %e\n", residual);
+    printStopReason(reason);
+    return result;
+}